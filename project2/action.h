@@ -93,25 +93,25 @@ protected:
 class action::place : public action {
 public:
 	static constexpr unsigned type = type_flag('p');
-	place(unsigned pos, unsigned tile, unsigned hint) : action(place::type | (pos & 0x0f) | ((tile & 0x0f) << 4) | ((hint & 0x0f) << 8)) {}
+	place(unsigned pos, unsigned tile, unsigned hint) : action(place::type | (pos & 0xff) | ((tile & 0x0f) << 8) | ((hint & 0x0f) << 12)) {}
 	place(const action& a = {}) : action(a) {}
-	unsigned position() const { return event() & 0x0f; }
-	unsigned tile() const { return (event() >> 4) & 0x0f; }
-	unsigned hint() const { return (event() >> 8) & 0x0f; }
+	unsigned position() const { return event() & 0xff; } // 8 bits for the positions of a board larger than 4x4
+	unsigned tile() const { return (event() >> 8) & 0x0f; }
+	unsigned hint() const { return (event() >> 12) & 0x0f; }
 public:
 	board::reward apply(board& b) const {
 		return b.place(position(), tile(), hint());
 	}
 	std::ostream& operator >>(std::ostream& out) const {
 		const char* idx = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ?";
-		return out << idx[position()] << idx[std::min(tile(), 36u)] << idx[std::min(hint(), 36u)];
+		return out << idx[std::min(position(), 36u)] << idx[std::min(tile(), 36u)] << idx[std::min(hint(), 36u)];
 	}
 	std::istream& operator <<(std::istream& in) {
 		const char* idx = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 		if (in.peek() != '#' && in) {
 			char p, t, h;
 			in >> p >> t >> h;
-			unsigned pos = std::find(idx, idx + 16, p) - idx;
+			unsigned pos = std::find(idx, idx + 36, p) - idx;
 			unsigned tile = std::find(idx, idx + 36, t) - idx;
 			unsigned hint = std::find(idx, idx + 36, h) - idx;
 			operator =(action::place(pos, tile, hint));
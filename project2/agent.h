@@ -15,13 +15,25 @@
 #include <type_traits>
 #include <algorithm>
 #include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <cstring>
+#include <stdexcept>
 #include "board.h"
 #include "action.h"
 #include "weight.h"
+#include "compact.h"
+#include "layout.h"
+#include "expectimax.h"
+#include "pattern.h"
 
-class agent {
+/**
+ * the agent of a board of the given geometry, where agent is of the standard board
+ */
+template<class board_t>
+class basic_agent {
 public:
-	agent(const std::string& args = "") {
+	basic_agent(const std::string& args = "") {
 		std::stringstream ss("name=unknown role=unknown " + args);
 		for (std::string pair; ss >> pair; ) {
 			std::string key = pair.substr(0, pair.find('='));
@@ -29,11 +41,11 @@ public:
 			meta[key] = { value };
 		}
 	}
-	virtual ~agent() {}
+	virtual ~basic_agent() {}
 	virtual void open_episode(const std::string& flag = "") {}
 	virtual void close_episode(const std::string& flag = "") {}
-	virtual action take_action(const board& b) { return action(); }
-	virtual bool check_for_win(const board& b) { return false; }
+	virtual action take_action(const board_t& b) { return action(); }
+	virtual bool check_for_win(const board_t& b) { return false; }
 
 public:
 	virtual std::string property(const std::string& key) const { return meta.at(key); }
@@ -52,21 +64,33 @@ protected:
 	std::map<key, value> meta;
 };
 
+typedef basic_agent<board> agent;
+
 /**
  * base agent for agents with randomness
  */
-class random_agent : public agent {
+template<class board_t>
+class basic_random_agent : public basic_agent<board_t> {
 public:
-	random_agent(const std::string& args = "") : agent(args) {
+	basic_random_agent(const std::string& args = "") : basic_agent<board_t>(args) {
 		if (meta.find("seed") != meta.end())
 			engine.seed(int(meta["seed"]));
 	}
-	virtual ~random_agent() {}
+	virtual ~basic_random_agent() {}
+
+	/**
+	 * the state of the random engine, e.g., for resuming a training
+	 */
+	std::string state() const { std::stringstream ss; ss << engine; return ss.str(); }
+	void state(const std::string& s) { std::stringstream(s) >> engine; }
 
 protected:
+	using basic_agent<board_t>::meta;
 	std::default_random_engine engine;
 };
 
+typedef basic_random_agent<board> random_agent;
+
 /**
  * base agent for agents with weight tables and a learning rate
  */
@@ -119,35 +143,111 @@ protected:
 };
 
 //tuple network player
-class tuple_player:public agent{
+//the patterns are of the geometry of the board, see pattern.h, where tuple_player is of the standard board
+template<class board_t>
+class basic_tuple_player:public basic_agent<board_t>{
+	typedef tuple_patterns<board_t> patterns;
 
 public:
-	tuple_player(const std::string& args = "") : agent(args), alpha(0.1f/64.0f) {
+	basic_tuple_player(const std::string& args = "") : basic_agent<board_t>(args),
+		tables(std::make_shared<std::vector<weight>>()), net(*tables), alpha(0.1f/64.0f), layout(index_layout::base16), deferred(false), batch(0), batched(0) {
+		if (meta.find("stages") != meta.end())
+			init_stages(meta["stages"]);
 		if (meta.find("init") != meta.end())
 			init_weights(meta["init"]);
 		if (meta.find("load") != meta.end())
 			load_weights(meta["load"]);
+		if (net.size() || packed)
+			check_stages();
 		if (meta.find("alpha") != meta.end())
 			alpha = float(meta["alpha"]);
+		if (meta.find("layout") != meta.end())
+			layout = index_layout::parse(meta["layout"]);
+		if (packed && alpha != 0)
+			throw std::invalid_argument("a compacted network is read-only, use alpha=0");
+		if (meta.find("batch") != meta.end()) {
+			batch = meta["batch"];
+			if (net.size() > 256 || std::any_of(net.begin(), net.end(), [](const weight& w) { return w.size() > (1u << 24); }))
+				throw std::invalid_argument("batched updates support at most 256 tables of 2^24 entries");
+		}
+		if (meta.find("visits") != meta.end()) {
+			visits = std::make_shared<feature_counter>();
+			if (!visits->load(meta["visits"]) || !visits->match(net)) visits->reset(net); // the counts of another network are discarded
+		}
+		if (meta.find("depth") != meta.end() && int(meta["depth"]) > 1) {
+			unsigned timeout = meta.find("timeout") != meta.end() ? unsigned(meta["timeout"]) : 0;
+			unsigned split = meta.find("split") != meta.end() ? unsigned(meta["split"]) : 2;
+			unsigned bits = meta.find("table") != meta.end() ? unsigned(meta["table"]) : 20;
+			search.reset(new basic_expectimax<board_t>(evaluator(), meta["depth"], timeout, split, bits));
+		}
 	}
-	virtual ~tuple_player() {
+	virtual ~basic_tuple_player() {
+		flush_updates();
 		if (meta.find("save") != meta.end())
 			save_weights(meta["save"]);
+		if (meta.find("visits") != meta.end())
+			visits->save(meta["visits"]);
+	}
+
+	/**
+	 * create a player sharing the weight tables with this one, e.g., for playing games in parallel
+	 * the fork neither loads nor saves the weights, and it updates the shared tables without locking
+	 */
+	std::unique_ptr<basic_tuple_player> fork() const {
+		std::unique_ptr<basic_tuple_player> twin(new basic_tuple_player("name=" + this->name() + " role=" + this->role(), tables));
+		twin->alpha = alpha;
+		twin->layout = layout;
+		twin->packed = packed;
+		twin->visits = visits;
+		twin->batch = batch;
+		twin->thresholds = thresholds;
+		if (search) twin->search.reset(new basic_expectimax<board_t>(*search, twin->evaluator()));
+		return twin;
+	}
+
+	/**
+	 * the pending updates of training, keyed by (table << 32 | index)
+	 */
+	typedef std::unordered_map<uint64_t, float> update_buffer;
+
+	/**
+	 * defer the updates of training into a buffer instead of writing the tables, while the player
+	 * still sees its own pending updates, so that games can be trained in parallel on fixed weights
+	 * and then merged in a fixed order by apply_updates, which is reproducible for any thread count
+	 */
+	void defer_updates(bool defer) { deferred = defer; }
+	update_buffer take_updates() {
+		update_buffer buf;
+		buf.swap(updates);
+		return buf;
+	}
+	void apply_updates(const update_buffer& buf) {
+		for (const auto& u : buf) net[u.first >> 32][u.first & 0xffffffffu] += u.second;
+		if (search && buf.size()) search->cache().advance();
 	}
 
 	struct state{
-		board after;
+		board_t after;
 		int reward;
 	};
 
-	virtual action take_action(const board& before){
+	virtual action take_action(const board_t& before){
+		if (search) {
+			board_t after = before;
+			int op = search->search(before);
+			if (op == -1) return action();
+			int reward = after.slide(op); // slide first, since the initializers of epi are evaluated in order
+			struct state epi={after,reward};
+			episode.push_back(epi);
+			return action::slide(op);
+		}
 		//std::shuffle(opcode.begin(), opcode.end(), engine);
 		int best_reward = -1;
 		float best_value=-9999999;
-		board after;
+		board_t after;
 		int best_op = -1;
 		for (int f_op : {0,1,2,3}) {
-			board temp=before;
+			board_t temp=before;
 			int f_reward = temp.slide(f_op);
 			if(f_reward==-1){
 				continue;
@@ -172,28 +272,54 @@ public:
 	}
 
 
-	int evaluate_feature(board& after, int net_index[6]){
+	int evaluate_feature(board_t& after, const int net_index[6]){
+		if (layout == index_layout::interleave) {
+			unsigned t[6] = { after(net_index[0]), after(net_index[1]), after(net_index[2]),
+				after(net_index[3]), after(net_index[4]), after(net_index[5]) };
+			return index_layout::encode(index_layout::interleave, t);
+		}
 		return after(net_index[0])*16*16*16*16*16+after(net_index[1])*16*16*16*16+after(net_index[2])*16*16*16+
 		after(net_index[3])*16*16+after(net_index[4])*16+after(net_index[5]);
 	}
 
-	float evaluate_score(board& after){
+	float evaluate_score(board_t& after){
 		float score=0;
-		for(int i=0;i<64;i++){
-			int j=i/8;
+		int base=stage(after)*tuples;
+		if (packed) {
+			for(unsigned i=0;i<patterns::count;i++){
+				score+=(*packed)[base+i/patterns::isomorphisms][evaluate_feature(after,network_index[i])];
+			}
+			return score;
+		}
+		if (updates.size()) {
+			for(unsigned i=0;i<patterns::count;i++){
+				int j=base+i/patterns::isomorphisms;
+				int index=evaluate_feature(after,network_index[i]);
+				auto it=updates.find(uint64_t(j)<<32|index);
+				score+=net[j][index]+(it!=updates.end()?it->second:0);
+			}
+			return score;
+		}
+		for(unsigned i=0;i<patterns::count;i++){
+			int j=base+i/patterns::isomorphisms;
 			score+=net[j][evaluate_feature(after,network_index[i])];
 		}
 		
 		return score;
 	}
 	
-	void train_weights(board& after, float target){
+	void train_weights(board_t& after, float target){
 		float temp=evaluate_score(after);
 		float err=target-temp;
 		float adjust_value=err*alpha;
-		for(int i=0;i<64;i++){
-			int j=i/8;
-			net[j][evaluate_feature(after,network_index[i])]+=adjust_value;
+		int base=stage(after)*tuples;
+		for(unsigned i=0;i<patterns::count;i++){
+			int j=base+i/patterns::isomorphisms;
+			int index=evaluate_feature(after,network_index[i]);
+			if (deferred) updates[uint64_t(j)<<32|index]+=adjust_value;
+			else if (batch) pending.emplace_back(uint32_t(j)<<24|index, adjust_value);
+			else net[j][index]+=adjust_value;
+			if (visits) visits->touch(j, index);
 		}
 		
 		/*
@@ -236,16 +362,112 @@ public:
 		episode.clear();
 	}
 	virtual void close_episode(const std::string& flag = "") {
-		if(episode.empty()){
+		if(episode.empty() || packed){
 			return;
 		}
 		train_weights(episode[episode.size()-1].after,0);
 		for(int i=episode.size()-2;i>=0;i--){
 			train_weights(episode[i].after,episode[i+1].reward+evaluate_score(episode[i+1].after));
 		}
+		if (batch && ++batched % batch == 0) flush_updates();
+		if (search && alpha != 0 && !deferred) search->cache().advance();
 	}
 
+	/**
+	 * save and restore the training state, i.e., the weights and the episode counter of batch=K,
+	 * where the pending updates are applied before saving
+	 */
+	void save_state(std::ostream& out) {
+		flush_updates();
+		uint64_t episodes = batched;
+		out.write(reinterpret_cast<char*>(&episodes), sizeof(episodes));
+		write_weights(out);
+	}
+	void load_state(std::istream& in) {
+		uint64_t episodes = 0;
+		in.read(reinterpret_cast<char*>(&episodes), sizeof(episodes));
+		batched = episodes;
+		read_weights(in);
+		if (search) search->cache().advance();
+	}
+
+	/**
+	 * apply the pending updates of batch=K in the order of addresses, i.e., (table << 24 | index),
+	 * where the updates are radix sorted by 3 passes of 11 bits, and the duplicates are coalesced
+	 * note that the targets of the episodes in a batch are computed without the pending updates
+	 */
+	void flush_updates() {
+		if (pending.empty()) return;
+		std::vector<std::pair<uint32_t, float>>& sorted = scratch;
+		sorted.resize(pending.size());
+		for (int shift = 0; shift < 33; shift += 11) {
+			size_t count[2049] = {};
+			for (const auto& u : pending) count[((u.first >> shift) & 2047) + 1]++;
+			for (int d = 0; d < 2048; d++) count[d + 1] += count[d];
+			for (const auto& u : pending) sorted[count[(u.first >> shift) & 2047]++] = u;
+			pending.swap(sorted);
+		}
+		for (size_t i = 0; i < pending.size(); ) {
+			uint32_t key = pending[i].first;
+			float delta = 0;
+			for (; i < pending.size() && pending[i].first == key; i++) delta += pending[i].second;
+			net[key >> 24][key & 0xffffffu] += delta;
+		}
+		pending.clear();
+	}
+
+	/**
+	 * the stage of a board, i.e., the number of stage thresholds reached by its largest tile,
+	 * where stage s is evaluated and trained by tables [s * tuples, (s + 1) * tuples) only
+	 */
+	unsigned stage(const board_t& after) const {
+		if (thresholds.empty()) return 0;
+		typename board_t::cell top = *std::max_element(after.begin(), after.end());
+		unsigned s = 0;
+		while (s < thresholds.size() && top >= thresholds[s]) s++;
+		return s;
+	}
+	unsigned stages() const { return thresholds.size() + 1; }
+
 protected:
+	/**
+	 * parse the stage thresholds as comma-separated tile values, e.g., "384,768" for 3 stages
+	 */
+	void init_stages(const std::string& info) {
+		std::string res = info;
+		for (char& ch : res)
+			if (!std::isdigit(ch)) ch = ' ';
+		std::stringstream in(res);
+		for (unsigned tile; in >> tile; ) {
+			typename board_t::cell t = board_t::ttoi(tile);
+			if (tile < 3 || board_t::itot(t) != tile || (thresholds.size() && t <= thresholds.back()))
+				throw std::invalid_argument("invalid stage thresholds: " + info);
+			thresholds.push_back(t);
+		}
+	}
+	/**
+	 * make sure that every stage has its tables, where the tables of a single-stage network are
+	 * copied to all stages, e.g., to start a staged training from a trained network
+	 */
+	void check_stages() {
+		if (thresholds.empty()) return;
+		size_t size = packed ? packed->size() : net.size();
+		if (size == tuples * stages()) return;
+		if (size != tuples || packed)
+			throw std::invalid_argument("a network of " + std::to_string(stages()) + " stages needs "
+				+ std::to_string(tuples) + " or " + std::to_string(tuples * stages()) + " tables");
+		net.reserve(tuples * stages());
+		for (unsigned s = 1; s < stages(); s++)
+			for (size_t i = 0; i < tuples; i++) net.push_back(net[i]);
+	}
+	/**
+	 * the path of a stage, i.e., the path with '%' replaced by the stage number, e.g., "weights.%.bin"
+	 */
+	static std::string stage_path(const std::string& path, unsigned s) {
+		std::string res = path;
+		return res.replace(res.find('%'), 1, std::to_string(s));
+	}
+
 	virtual void init_weights(const std::string& info) {
 		
 		std::string res = info; // comma-separated sizes, e.g., "65536,65536"
@@ -259,104 +481,85 @@ protected:
 
 	}
 	virtual void load_weights(const std::string& path) {
+		if (path.find('%') != std::string::npos) { // one network of each stage
+			std::vector<weight> all;
+			for (unsigned s = 0; s < stages(); s++) {
+				load_weights(stage_path(path, s));
+				if (packed || net.size() != tuples)
+					throw std::invalid_argument(stage_path(path, s) + " is not a network of a single stage");
+				for (weight& w : net) all.push_back(std::move(w));
+			}
+			net.swap(all);
+			return;
+		}
 		std::ifstream in(path, std::ios::in | std::ios::binary);
 		if (!in.is_open()) std::exit(-1);
-		uint32_t size;
-		in.read(reinterpret_cast<char*>(&size), sizeof(size));
-		net.resize(size);
-		for (weight& w : net) in >> w;
+		char magic[4] = {};
+		in.read(magic, 4);
+		if (std::memcmp(magic, "TPCK", 4) == 0) { // compacted by --compact, see compact.h
+			uint32_t size;
+			in.read(reinterpret_cast<char*>(&size), sizeof(size));
+			packed = std::make_shared<std::vector<compact_weight>>(size);
+			for (compact_weight& w : *packed) in >> w;
+			in.close();
+			return;
+		}
+		in.seekg(0);
+		read_weights(in);
 		in.close();
 	}
 	virtual void save_weights(const std::string& path) {
+		if (path.find('%') != std::string::npos) { // one network of each stage
+			for (unsigned s = 0; s < stages(); s++) {
+				std::ofstream out(stage_path(path, s), std::ios::out | std::ios::binary | std::ios::trunc);
+				if (!out.is_open()) std::exit(-1);
+				write_weights(out, s * tuples, tuples);
+			}
+			return;
+		}
 		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
 		if (!out.is_open()) std::exit(-1);
-		uint32_t size = net.size();
-		out.write(reinterpret_cast<char*>(&size), sizeof(size));
-		for (weight& w : net) out << w;
+		write_weights(out);
 		out.close();
 	}
+	void read_weights(std::istream& in) {
+		uint32_t size;
+		in.read(reinterpret_cast<char*>(&size), sizeof(size));
+		net.resize(size);
+		for (weight& w : net) in >> w;
+	}
+	void write_weights(std::ostream& out, size_t first = 0, size_t count = -1) {
+		count = std::min(count, net.size() - first);
+		uint32_t size = count;
+		out.write(reinterpret_cast<char*>(&size), sizeof(size));
+		for (size_t i = first; i < first + count; i++) out << net[i];
+	}
 
 protected:
-	std::vector<weight> net;
-	float alpha;
-		//0 1 2 3
-		//4 5 6 7
-		//8 9 10 11
-		//12 13 14 15
-	std::vector<state> episode;
-	int network_index[64][6]={
-		{0,1,2,4,5,6},
-		{2,3,6,7,10,11},
-		{9,10,11,13,14,15},
-		{4,5,8,9,12,13},
-		{8,9,10,12,13,14},
-		{0,1,4,5,8,9},
-		{1,2,3,5,6,7},
-		{6,7,10,11,14,15},
+	basic_tuple_player(const std::string& args, std::shared_ptr<std::vector<weight>> tables) : basic_agent<board_t>(args),
+		tables(tables), net(*this->tables), alpha(0), layout(index_layout::base16), deferred(false), batch(0), batched(0) {}
 
-		{1,2,5,6,9,13},
-		{4,5,6,7,10,11},
-		{2,6,10,14,13,9},
-		{4,5,8,9,10,11},
-		{1,2,5,6,10,14},
-		{6,7,8,9,10,11},
-		{1,5,9,10,13,14},
-		{4,5,6,7,8,9},
+	typename basic_expectimax<board_t>::evaluator evaluator() {
+		return [this](const board_t& after) { board_t b = after; return evaluate_score(b); };
+	}
 
-		{0,1,2,3,4,5},
-		{2,6,3,7,11,15},
-		{12,13,14,15,10,11},
-		{0,4,8,12,9,13},
-		{8,9,12,13,14,15},
-		{0,1,4,5,8,12},
-		{0,1,2,3,6,7},
-		{3,7,10,11,14,15},
-
-		{0,1,6,7,8,11},
-		{3,7,6,9,10,14,},
-		{5,8,9,10,15},
-		{1,5,6,8,9,12},
-		{6,9,10,11,12,13},
-		{0,4,5,9,10,13},
-		{2,3,4,5,6,9},
-		{2,5,6,10,11,15},
-
-		{0,1,2,5,9,10},
-		{3,5,6,7,9,11},
-		{5,6,10,13,14,15},
-		{4,6,8,9,10,12},
-		{5,6,9,12,13,14},
-		{0,4,5,6,8,10},
-		{1,2,3,6,9,10},
-		{5,7,9,10,11,15},
-
-		{0,1,5,9,13,14},
-		{3,4,5,6,7,8},
-		{1,2,6,10,14,15},
-		{7,8,9,10,11,12},
-		{1,2,5,9,12,13},
-		{0,4,5,6,7,11},
-		{2,3,6,10,13,14},
-		{4,8,9,10,11,15},
-
-		{0,1,5,8,9,13},
-		{1,3,4,5,6,7},
-		{2,6,7,10,14,15},
-		{8,9,10,11,12,14},
-		{1,4,5,9,12,13},
-		{0,2,4,5,6,7},
-		{2,3,6,10,11,14},
-		{8,9,10,11,13,15},
-
-		{0,1,2,4,6,10},
-		{2,3,7,9,10,11},
-		{5,9,11,13,14,15},
-		{4,5,6,8,12,13},
-		{2,6,8,10,12,14},
-		{0,1,4,8,9,10},
-		{1,2,3,5,7,9},
-		{5,6,7,11,14,15}
-	};
+protected:
+	using basic_agent<board_t>::meta;
+	std::shared_ptr<std::vector<weight>> tables;
+	std::vector<weight>& net;
+	float alpha;
+	index_layout::type layout; // the index layout of features, which is not recorded in the weight file
+	std::unique_ptr<basic_expectimax<board_t>> search;
+	std::shared_ptr<std::vector<compact_weight>> packed; // the read-only compacted network, if loaded
+	std::shared_ptr<feature_counter> visits;
+	bool deferred;
+	update_buffer updates;
+	size_t batch, batched; // the number of episodes of each batch of updates, and the number of episodes so far
+	std::vector<std::pair<uint32_t, float>> pending, scratch;
+	static constexpr size_t tuples = patterns::tuples; // the number of tables of a stage
+	std::vector<typename board_t::cell> thresholds; // the tile indices that start the stages after the first
+	std::vector<state> episode;
+	const int (*network_index)[6] = patterns::index(); // the cells of each pattern
 	/*
 	int network_index[32][6]={
 		
@@ -404,34 +607,37 @@ protected:
 
 };
 
+template<class board_t> constexpr size_t basic_tuple_player<board_t>::tuples;
+
+typedef basic_tuple_player<board> tuple_player;
+
 /**
  * default random environment, i.e., placer
  * place the hint tile and decide a new hint tile
  */
-class random_placer : public random_agent {
+template<class board_t>
+class basic_random_placer : public basic_random_agent<board_t> {
 public:
-	random_placer(const std::string& args = "") : random_agent("name=place role=placer " + args) {
-		spaces[0] = { 12, 13, 14, 15 };
-		spaces[1] = { 0, 4, 8, 12 };
-		spaces[2] = { 0, 1, 2, 3};
-		spaces[3] = { 3, 7, 11, 15 };
-		spaces[4] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+	basic_random_placer(const std::string& args = "") : basic_random_agent<board_t>("name=place role=placer " + args) {
+		for (unsigned last = 0; last <= 4; last++)
+			for (unsigned i = 0; i < board_t::edges(last); i++)
+				spaces[last].push_back(board_t::edge(last, i));
 	}
 
-	virtual action take_action(const board& after) {
+	virtual action take_action(const board_t& after) {
 		std::vector<int> space = spaces[after.last()];
 		std::shuffle(space.begin(), space.end(), engine);
 		for (int pos : space) {
 			if (after(pos) != 0) continue;
 
 			int bag[3], num = 0;
-			for (board::cell t = 1; t <= 3; t++)
+			for (typename board_t::cell t = 1; t <= 3; t++)
 				for (size_t i = 0; i < after.bag(t); i++)
 					bag[num++] = t;
 			std::shuffle(bag, bag + num, engine);
 
-			board::cell tile = after.hint() ?: bag[--num];
-			board::cell hint = bag[--num];
+			typename board_t::cell tile = after.hint() ?: bag[--num];
+			typename board_t::cell hint = bag[--num];
 
 			return action::place(pos, tile, hint);
 		}
@@ -439,32 +645,39 @@ public:
 	}
 
 private:
+	using basic_random_agent<board_t>::engine;
 	std::vector<int> spaces[5];
 };
 
+typedef basic_random_placer<board> random_placer;
+
 
 /**
  * random player, i.e., slider
  * select a legal action randomly
  */
-class random_slider : public random_agent {
+template<class board_t>
+class basic_random_slider : public basic_random_agent<board_t> {
 public:
-	random_slider(const std::string& args = "") : random_agent("name=slide role=slider " + args),
+	basic_random_slider(const std::string& args = "") : basic_random_agent<board_t>("name=slide role=slider " + args),
 		opcode({ 0, 1, 2, 3 }) {}
 
-	virtual action take_action(const board& before) {
+	virtual action take_action(const board_t& before) {
 		std::shuffle(opcode.begin(), opcode.end(), engine);
 		for (int op : opcode) {
-			board::reward reward = board(before).slide(op);
+			typename board_t::reward reward = board_t(before).slide(op);
 			if (reward != -1) return action::slide(op);
 		}
 		return action();
 	}
 
 private:
+	using basic_random_agent<board_t>::engine;
 	std::array<int, 4> opcode;
 };
 
+typedef basic_random_slider<board> random_slider;
+
 class my_player : public agent {
 public:
 	my_player(const std::string& args = "") : agent(args),
@@ -0,0 +1,240 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * alloc.h: Accounting of heap allocations by the global operator new
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+
+/**
+ * count the heap allocations of the program, once enabled by start, e.g., by --alloc
+ *
+ * every allocation is counted into the phase of its thread, i.e., who is allocating, e.g., the slider,
+ * and into the total of its thread, so that an episode counts the allocations of its own game even
+ * if games are played in parallel; every 'sample'-th allocation of a thread also records its call site
+ * by backtrace, and the sites of the most allocations are reported at exit
+ *
+ * note that this header replaces the global operator new and delete, so it must be part of exactly one
+ * translation unit, which holds for threes.cpp; the replacement only adds an untaken branch when disabled
+ *
+ * the arguments are given as "key=value" pairs, e.g., "sample=1000 top=10"
+ *  'sample': the period of sampling call sites in allocations of a thread (default 1000, 0 for none)
+ *  'top': the number of call sites to report (default 10)
+ */
+class allocation {
+public:
+	enum phase { other, slide, place, train, phases };
+
+	struct counter {
+		uint64_t count, bytes;
+		counter operator -(const counter& c) const { return { count - c.count, bytes - c.bytes }; }
+		counter& operator +=(const counter& c) { count += c.count; bytes += c.bytes; return *this; }
+	};
+
+	static void start(const std::string& args = "") {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "sample") period() = std::stoul(value);
+			else if (key == "top") top() = std::stoul(value);
+			else throw std::invalid_argument("invalid alloc argument: " + pair);
+		}
+		void* warm[max_frames];
+		backtrace(warm, max_frames); // load the unwinder before it is called in operator new
+		enabled().store(true, std::memory_order_release);
+	}
+	static bool is_enabled() { return enabled().load(std::memory_order_relaxed); }
+
+	/**
+	 * the allocations of the calling thread so far
+	 */
+	static counter current() { return local(); }
+
+	/**
+	 * set the phase of the calling thread in a scope
+	 */
+	class scope {
+	public:
+		scope(phase p) : last(current_phase()) { current_phase() = p; }
+		~scope() { current_phase() = last; }
+	private:
+		phase last;
+	};
+
+	/**
+	 * the accounting of operator new, see the end of this file
+	 */
+	static void account(size_t size) {
+		if (!enabled().load(std::memory_order_relaxed) || busy()) return;
+		busy() = true;
+		counter& c = local();
+		c.count++;
+		c.bytes += size;
+		totals()[current_phase()].count.fetch_add(1, std::memory_order_relaxed);
+		totals()[current_phase()].bytes.fetch_add(size, std::memory_order_relaxed);
+		if (period() && ++countdown() >= period()) {
+			countdown() = 0;
+			record(size);
+		}
+		busy() = false;
+	}
+
+	/**
+	 * print the allocations of each phase, and the call sites of the most sampled allocations
+	 *
+	 * the format is
+	 * alloc   phase   count   bytes
+	 *         other   1234    56789
+	 *         slide   0       0
+	 *         ...
+	 * alloc   site    samples bytes
+	 *         std::vector<...>::_M_realloc_insert(...) <- random_placer::take_action(...) <- ...
+	 *                 123     4567
+	 */
+	static void report(std::ostream& out = std::cout) {
+		if (!is_enabled()) return;
+		static const char* names[] = { "other", "slide", "place", "train" };
+		out << "alloc\t" "phase\t" "count\t" "bytes" << std::endl;
+		for (int p = 0; p < phases; p++)
+			out << "\t" << names[p] << "\t" << totals()[p].count << "\t" << totals()[p].bytes << std::endl;
+
+		std::map<std::string, counter> named; // the sites of different addresses in the same functions are merged
+		for (size_t i = 0; i < capacity; i++) {
+			const site& s = sites()[i];
+			if (!s.key.load(std::memory_order_acquire)) continue;
+			std::string name;
+			int shown = 0;
+			for (int f = 0; f < s.frames && shown < depth; f++) {
+				std::string frame = symbol(s.frame[f]);
+				if (shown == 0 && (frame.find("operator new") == 0 || frame.find("allocation::") == 0)) continue;
+				name += (shown++ ? " <- " : "") + frame;
+			}
+			named[name] += { s.count, s.bytes };
+		}
+		std::vector<std::pair<std::string, counter>> order(named.begin(), named.end());
+		std::stable_sort(order.begin(), order.end(), [](const std::pair<std::string, counter>& x,
+			const std::pair<std::string, counter>& y) { return x.second.count > y.second.count; });
+		if (order.size() > top()) order.resize(top());
+		if (order.empty()) return;
+		out << "alloc\t" "site\t" "samples\t" "bytes" << std::endl;
+		for (const auto& s : order)
+			out << "\t" << s.first << std::endl << "\t\t" << s.second.count << "\t" << s.second.bytes << std::endl;
+	}
+
+private:
+	static const int depth = 4; // the frames of a call site, from the caller of operator new
+	static const int max_frames = 8; // the frames recorded, including those of the accounting itself
+	static const size_t capacity = 4096; // the distinct call sites
+
+	struct total {
+		std::atomic<uint64_t> count, bytes;
+	};
+	struct site {
+		std::atomic<uint64_t> key; // the hash of the frames, or 0 if unused
+		std::atomic<uint64_t> count, bytes;
+		int frames;
+		void* frame[max_frames];
+	};
+
+	static std::atomic<bool>& enabled() { static std::atomic<bool> flag(false); return flag; }
+	static size_t& period() { static size_t n = 1000; return n; }
+	static size_t& top() { static size_t n = 10; return n; }
+	static total* totals() { static total t[phases]; return t; }
+	static site* sites() { static site s[capacity]; return s; }
+
+	static counter& local() { static thread_local counter c = { 0, 0 }; return c; }
+	static phase& current_phase() { static thread_local phase p = other; return p; }
+	static bool& busy() { static thread_local bool b = false; return b; }
+	static size_t& countdown() { static thread_local size_t n = 0; return n; }
+
+	/**
+	 * count a sampled allocation into the table of call sites, which is open addressing without locks
+	 */
+	static void record(size_t size) {
+		void* stack[max_frames];
+		int n = backtrace(stack, max_frames); // the frames of the accounting are skipped by report
+		uint64_t key = 0xcbf29ce484222325ull;
+		for (int i = 0; i < n; i++) key = (key ^ uint64_t(stack[i])) * 0x100000001b3ull;
+		key |= 1;
+		for (size_t i = key % capacity, probe = 0; probe < capacity; i = (i + 1) % capacity, probe++) {
+			site& s = sites()[i];
+			uint64_t k = 0;
+			if (s.key.compare_exchange_strong(k, key, std::memory_order_acq_rel)) { // a new site
+				s.frames = n;
+				std::copy(stack, stack + n, s.frame);
+			} else if (k != key) {
+				continue;
+			}
+			s.count.fetch_add(1, std::memory_order_relaxed);
+			s.bytes.fetch_add(size, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	static std::string symbol(void* pc) {
+		void* addr = static_cast<char*>(pc) - 1; // the call instruction of the return address
+		Dl_info info = {};
+		if (dladdr(addr, &info) && info.dli_sname) {
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			std::string name = status == 0 ? demangled : info.dli_sname;
+			std::free(demangled);
+			return name;
+		}
+		std::stringstream ss;
+		if (!info.dli_fname) return "[unknown]";
+		std::string module = info.dli_fname;
+		ss << module.substr(module.find_last_of('/') + 1) << "+0x" << std::hex;
+		ss << (static_cast<char*>(addr) - static_cast<char*>(info.dli_fbase));
+		return ss.str();
+	}
+
+public:
+	/**
+	 * allocate by malloc as the default operator new, and count the allocation
+	 */
+	static void* allocate(size_t size) {
+		void* p;
+		while ((p = std::malloc(size ? size : 1)) == nullptr) {
+			std::new_handler handler = std::get_new_handler();
+			if (!handler) throw std::bad_alloc();
+			handler();
+		}
+		account(size);
+		return p;
+	}
+};
+
+/**
+ * the replacement of the global allocation functions
+ */
+void* operator new(size_t size) { return allocation::allocate(size); }
+void* operator new[](size_t size) { return allocation::allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try { return allocation::allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	try { return allocation::allocate(size); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
@@ -0,0 +1,182 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * batch.h: Structure-of-arrays batch of boards with vectorizable slide kernels
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "board.h"
+
+/**
+ * a batch of N boards stored as structure of arrays, i.e., cell i of all boards is contiguous,
+ * so that one call slides all boards in the same direction with branchless lane-wise operations,
+ * which the compiler turns into SIMD instructions, e.g., 16 boards per 128-bit register
+ *
+ * the semantics are the same as board::slide and board::place, or those of board_t of another size
+ */
+template<size_t N = 16, class board_t = board>
+class board_batch {
+	static_assert(board_t::width == board_t::height, "the lanes of a batch are the lines of a square board");
+	static constexpr unsigned side = board_t::width;
+
+public:
+	board_batch() : count(0) {
+		for (unsigned i = 0; i < board_t::cells; i++)
+			for (size_t k = 0; k < N; k++) cells[i][k] = 0;
+		for (size_t k = 0; k < N; k++) attr[k] = 0;
+	}
+
+public:
+	size_t size() const { return count; }
+	bool full() const { return count == N; }
+	void clear() { count = 0; }
+
+	/**
+	 * append a board, return its index in the batch
+	 */
+	size_t push(const board_t& b) { set(count, b); return count++; }
+
+	void set(size_t k, const board_t& b) {
+		for (unsigned i = 0; i < board_t::cells; i++) cells[i][k] = b(i);
+		attr[k] = b.info();
+	}
+	board_t get(size_t k) const {
+		board_t b;
+		for (unsigned i = 0; i < board_t::cells; i++) b(i) = cells[i][k];
+		b.info(attr[k]);
+		return b;
+	}
+
+	/**
+	 * slide all boards in the same direction
+	 * the reward of each board is stored in 'reward', or -1 if the slide is illegal for it,
+	 * in which case the board is left unchanged, since no write of the kernel changes a stuck board
+	 */
+	void slide(unsigned opcode, typename board_t::reward reward[N]) {
+		const unsigned (&line)[side][side] = lines()[opcode & 0b11];
+		uint8_t moved[N] = {};
+		uint8_t level[side][side - 1][N]; // the index of the tile formed by each merge, or 0 if no merge
+		for (unsigned r = 0; r < side; r++) {
+			uint8_t v[side][N];
+			for (unsigned c = 0; c < side; c++)
+				for (size_t k = 0; k < N; k++) v[c][k] = cells[line[r][c]][k];
+			for (unsigned c = 1; c < side; c++) {
+				for (size_t k = 0; k < N; k++) {
+					uint8_t a = v[c - 1][k], b = v[c][k];
+					uint8_t empty = mask(a == 0), filled = mask(b != 0);
+					uint8_t merge = ~empty & filled & (mask(uint8_t(a + b) == 3) | (mask(a == b) & mask(a >= 3) & mask(a < 14)));
+					uint8_t up = (a > b ? a : b) + 1, keep = ~(empty | merge);
+					v[c - 1][k] = (b & empty) | (up & merge) | (a & keep);
+					v[c][k] = b & keep;
+					moved[k] |= (empty & filled) | merge;
+					level[r][c - 1][k] = up & merge;
+				}
+			}
+			for (unsigned c = 0; c < side; c++)
+				for (size_t k = 0; k < N; k++) cells[line[r][c]][k] = v[c][k];
+		}
+		for (size_t k = 0; k < N; k++) {
+			int32_t score = 0;
+			for (unsigned r = 0; r < side; r++)
+				for (unsigned c = 0; c < side - 1; c++) score += merge_reward(level[r][c][k]);
+			reward[k] = moved[k] ? score : -1;
+			if (moved[k]) attr[k] = (attr[k] & ~typename board_t::data(0xf0)) | ((opcode & 0b11) << 4);
+		}
+	}
+
+	/**
+	 * store the legal slides of each board as a 4-bit mask, bit i for opcode i
+	 */
+	void legal(uint8_t legal[N]) const {
+		for (size_t k = 0; k < N; k++) legal[k] = 0;
+		for (unsigned op = 0; op < 4; op++) {
+			const unsigned (&line)[side][side] = lines()[op];
+			for (unsigned r = 0; r < side; r++) {
+				for (unsigned c = 1; c < side; c++) {
+					const uint8_t* t0 = cells[line[r][c - 1]];
+					const uint8_t* t1 = cells[line[r][c]];
+					for (size_t k = 0; k < N; k++) {
+						uint8_t a = t0[k], b = t1[k];
+						uint8_t empty = mask(a == 0), filled = mask(b != 0);
+						uint8_t merge = ~empty & filled & (mask(uint8_t(a + b) == 3) | (mask(a == b) & mask(a >= 3) & mask(a < 14)));
+						uint8_t move = ((empty & filled) | merge) & 1;
+						legal[k] |= move << op;
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * place a tile on each board, the arrays are indexed by the boards
+	 * the reward of each board is stored in 'reward', or -1 if the placement is illegal for it
+	 *
+	 * the occupancy check and the write of the tiles are lane-wise selects over all cells, since the
+	 * positions differ by board, while the hint and the bag are updated per board on its info word
+	 */
+	void place(const unsigned pos[N], const typename board_t::cell tile[N], const typename board_t::cell hint[N], typename board_t::reward reward[N]) {
+		uint8_t at[N], put[N], value[N];
+		for (size_t k = 0; k < N; k++) {
+			at[k] = k < count && pos[k] < board_t::cells ? pos[k] : 0xff; // 0xff is no cell
+			value[k] = k < count ? tile[k] : 0;
+			put[k] = mask(at[k] != 0xff);
+		}
+		for (unsigned i = 0; i < board_t::cells; i++)
+			for (size_t k = 0; k < N; k++) put[k] &= ~(mask(at[k] == i) & mask(cells[i][k] != 0));
+		for (size_t k = 0; k < count; k++) {
+			board_t b;
+			b.info(attr[k]);
+			if (b.hint() == 0 && !b.extract_hint_from_bag(tile[k])) put[k] = 0;
+			if (b.hint() != tile[k] || !b.extract_hint_from_bag(hint[k])) put[k] = 0;
+			reward[k] = put[k] ? board_t::itov(tile[k]) : -1;
+			if (put[k]) b.last(4), attr[k] = b.info();
+		}
+		for (unsigned i = 0; i < board_t::cells; i++) {
+			for (size_t k = 0; k < N; k++) {
+				uint8_t sel = put[k] & mask(at[k] == i);
+				cells[i][k] = (value[k] & sel) | (cells[i][k] & ~sel);
+			}
+		}
+	}
+
+private:
+	/**
+	 * the cell indices of each line in the direction of sliding, i.e., line[r][0] is at the edge,
+	 * generated once from the geometry of the board
+	 */
+	static const unsigned (&lines())[4][side][side] {
+		struct table_t {
+			unsigned line[4][side][side];
+			table_t() {
+				for (unsigned op = 0; op < 4; op++)
+					for (unsigned r = 0; r < side; r++)
+						for (unsigned c = 0; c < side; c++) line[op][r][c] = board_t::index(op, r, c);
+			}
+		};
+		static const table_t table;
+		return table.line;
+	}
+
+	/**
+	 * all bits set if the condition holds, so that the lanes are selected without branches
+	 */
+	static uint8_t mask(bool cond) { return -uint8_t(cond); }
+
+	/**
+	 * the reward of forming a tile of index t, i.e., itov(t) - 2 * itov(t - 1), or 0 for no tile
+	 */
+	static int32_t merge_reward(uint8_t t) {
+		static const int32_t table[16] = { 0, 0, 0, 3, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683, 59049, 177147, 531441 };
+		return table[t & 0x0f];
+	}
+
+private:
+	alignas(64) uint8_t cells[board_t::cells][N]; // cells[i][k]: cell i of board k
+	typename board_t::data attr[N];
+	size_t count;
+};
@@ -9,47 +9,54 @@
 
 #pragma once
 #include <array>
+#include <string>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <cmath>
 
 /**
- * array-based board for Threes!
+ * array-based board for Threes! of W columns and H rows, where the geometry is fixed at compile time
+ * so that the loops of sliding are unrolled with constant cell indices
  *
- * index (1-d form):
+ * index (1-d form) of the 4x4 board, i.e., board:
  *  (0)  (1)  (2)  (3)
  *  (4)  (5)  (6)  (7)
  *  (8)  (9) (10) (11)
  * (12) (13) (14) (15)
  *
  */
-class board {
+template<unsigned W, unsigned H>
+class basic_board {
 public:
+	static constexpr unsigned width = W;
+	static constexpr unsigned height = H;
+	static constexpr unsigned cells = W * H;
+
 	typedef uint32_t cell;
-	typedef std::array<cell, 4> row;
-	typedef std::array<row, 4> grid;
+	typedef std::array<cell, W> row;
+	typedef std::array<row, H> grid;
 	typedef uint64_t data;
 	typedef uint64_t score;
 	typedef int reward;
 
 public:
-	board() : tile(), attr(0) { reset(); }
-	board(const grid& b, data v = 0) : tile(b), attr(v) {}
-	board(const board& b) = default;
-	board& operator =(const board& b) = default;
+	basic_board() : tile(), attr(0) { reset(); }
+	basic_board(const grid& b, data v = 0) : tile(b), attr(v) {}
+	basic_board(const basic_board& b) = default;
+	basic_board& operator =(const basic_board& b) = default;
 
 	operator grid&() { return tile; }
 	operator const grid&() const { return tile; }
 	row& operator [](unsigned i) { return tile[i]; }
 	const row& operator [](unsigned i) const { return tile[i]; }
-	cell& operator ()(unsigned i) { return tile[i / 4][i % 4]; }
-	const cell& operator ()(unsigned i) const { return tile[i / 4][i % 4]; }
+	cell& operator ()(unsigned i) { return tile[i / W][i % W]; }
+	const cell& operator ()(unsigned i) const { return tile[i / W][i % W]; }
 
 	cell* begin() { return &(operator()(0)); }
 	const cell* begin() const { return &(operator()(0)); }
-	cell* end() { return begin() + 16; }
-	const cell* end() const { return begin() + 16; }
+	cell* end() { return begin() + cells; }
+	const cell* end() const { return begin() + cells; }
 
 	data info() const { return attr; }
 	data info(data dat) { data old = attr; attr = dat; return old; }
@@ -88,17 +95,39 @@ public:
 	}
 	unsigned value() const {
 		score v = 0;
-		for (cell t : *this) v += board::itov(t);
+		for (cell t : *this) v += itov(t);
 		return v;
 	}
 
 public:
-	bool operator ==(const board& b) const { return tile == b.tile; }
-	bool operator < (const board& b) const { return tile <  b.tile; }
-	bool operator !=(const board& b) const { return !(*this == b); }
-	bool operator > (const board& b) const { return b < *this; }
-	bool operator <=(const board& b) const { return !(b < *this); }
-	bool operator >=(const board& b) const { return !(*this < b); }
+	/**
+	 * the geometry of sliding, where opcode 0, 1, 2, 3 is up, right, down, left
+	 * a slide moves the tiles of each line toward its head, e.g., the lines of up are the columns
+	 * from top to bottom, so cell c of line r of a slide is index(op, r, c)
+	 */
+	static constexpr unsigned lines(unsigned op) { return op % 2 == 0 ? W : H; }
+	static constexpr unsigned length(unsigned op) { return op % 2 == 0 ? H : W; }
+	static constexpr unsigned index(unsigned op, unsigned r, unsigned c) {
+		return op == 0 ? c * W + r
+		     : op == 1 ? r * W + (W - 1 - c)
+		     : op == 2 ? (H - 1 - c) * W + r
+		     :           r * W + c;
+	}
+
+	/**
+	 * the cells where the environment may place a tile after the last slide, i.e., the tails of the lines,
+	 * or all cells at the beginning (last = 4); edge(last, i) is the i-th of edges(last) cells
+	 */
+	static constexpr unsigned edges(unsigned last) { return last < 4 ? lines(last) : cells; }
+	static constexpr unsigned edge(unsigned last, unsigned i) { return last < 4 ? index(last, i, length(last) - 1) : i; }
+
+public:
+	bool operator ==(const basic_board& b) const { return tile == b.tile; }
+	bool operator < (const basic_board& b) const { return tile <  b.tile; }
+	bool operator !=(const basic_board& b) const { return !(*this == b); }
+	bool operator > (const basic_board& b) const { return b < *this; }
+	bool operator <=(const basic_board& b) const { return !(b < *this); }
+	bool operator >=(const basic_board& b) const { return !(*this < b); }
 
 public:
 
@@ -108,7 +137,7 @@ public:
 	 */
 	reward place(unsigned pos, cell tile, cell hint_tile) {
 		data bak = info();
-		if (pos >= 16 || operator()(pos)) return -1;
+		if (pos >= cells || operator()(pos)) return -1;
 		if (hint() == 0 && !extract_hint_from_bag(tile)) return -1;
 		if (hint() != tile) return info(bak), -1;
 		if (!extract_hint_from_bag(hint_tile)) return info(bak), -1;
@@ -133,50 +162,10 @@ public:
 		return r;
 	}
 
-	
-
-	reward slide_left() {
-		bool moved = false;
-		reward score = 0;
-		merge_count=0;
-		for (int r = 0; r < 4; r++) {
-			auto& row = tile[r];
-			for (int c = 1; c < 4; c++) {
-				auto& t0 = row[c - 1];
-				auto& t1 = row[c];
-				if (t0 == 0) {
-					t0 = t1;
-					t1 = 0;
-					moved |= (t0 != 0);
-					merge_count+=1;
-				} else if (t1 != 0 && ((t0 + t1 == 3) || (t0 == t1 && t0 >= 3 && t0 < 14))) {
-					t0 = std::max(t0, t1) + 1;
-					t1 = 0;
-					score += itov(t0) - itov(t0 - 1) * 2;
-					moved = true;
-				}
-			}
-		}
-		return (moved) ? score : -1;
-	}
-	reward slide_right() {
-		reflect_horizontal();
-		reward score = slide_left();
-		reflect_horizontal();
-		return score;
-	}
-	reward slide_up() {
-		rotate_clockwise();
-		reward score = slide_right();
-		rotate_counterclockwise();
-		return score;
-	}
-	reward slide_down() {
-		rotate_clockwise();
-		reward score = slide_left();
-		rotate_counterclockwise();
-		return score;
-	}
+	reward slide_left() { return slide_lines<3>(); }
+	reward slide_right() { return slide_lines<1>(); }
+	reward slide_up() { return slide_lines<0>(); }
+	reward slide_down() { return slide_lines<2>(); }
 
 	void rotate(int clockwise_count = 1) {
 		switch (((clockwise_count % 4) + 4) % 4) {
@@ -193,22 +182,25 @@ public:
 	void reverse() { reflect_horizontal(); reflect_vertical(); }
 
 	void reflect_horizontal() {
-		for (int r = 0; r < 4; r++) {
-			std::swap(tile[r][0], tile[r][3]);
-			std::swap(tile[r][1], tile[r][2]);
+		for (unsigned r = 0; r < H; r++) {
+			for (unsigned c = 0; c < W / 2; c++) {
+				std::swap(tile[r][c], tile[r][W - 1 - c]);
+			}
 		}
 	}
 
 	void reflect_vertical() {
-		for (int c = 0; c < 4; c++) {
-			std::swap(tile[0][c], tile[3][c]);
-			std::swap(tile[1][c], tile[2][c]);
+		for (unsigned c = 0; c < W; c++) {
+			for (unsigned r = 0; r < H / 2; r++) {
+				std::swap(tile[r][c], tile[H - 1 - r][c]);
+			}
 		}
 	}
 
 	void transpose() {
-		for (int r = 0; r < 4; r++) {
-			for (int c = r + 1; c < 4; c++) {
+		static_assert(W == H, "only a square board can be transposed");
+		for (unsigned r = 0; r < H; r++) {
+			for (unsigned c = r + 1; c < W; c++) {
 				std::swap(tile[r][c], tile[c][r]);
 			}
 		}
@@ -218,10 +210,40 @@ public:
 		return merge_count;
 	}
 
+private:
+	/**
+	 * slide all lines toward their heads, where each tile moves at most one cell:
+	 * into an empty cell, or merging with the next tile (1 + 2, or two equal tiles of 3 or more)
+	 */
+	template<unsigned op>
+	reward slide_lines() {
+		bool moved = false;
+		reward score = 0;
+		merge_count=0;
+		for (unsigned r = 0; r < lines(op); r++) {
+			for (unsigned c = 1; c < length(op); c++) {
+				cell& t0 = operator()(index(op, r, c - 1));
+				cell& t1 = operator()(index(op, r, c));
+				if (t0 == 0) {
+					t0 = t1;
+					t1 = 0;
+					moved |= (t0 != 0);
+					merge_count+=1;
+				} else if (t1 != 0 && ((t0 + t1 == 3) || (t0 == t1 && t0 >= 3 && t0 < 14))) {
+					t0 = std::max(t0, t1) + 1;
+					t1 = 0;
+					score += itov(t0) - itov(t0 - 1) * 2;
+					moved = true;
+				}
+			}
+		}
+		return (moved) ? score : -1;
+	}
+
 public:
-	friend std::ostream& operator <<(std::ostream& out, const board& b) {
-		out << "+------------------------+" << std::endl;
-		for (int i = 0; i < 4; i++) {
+	friend std::ostream& operator <<(std::ostream& out, const basic_board& b) {
+		out << "+" << std::string(W * 6, '-') << "+" << std::endl;
+		for (unsigned i = 0; i < H; i++) {
 			auto& row = b[i];
 			out << "|" << std::dec;
 			for (auto t : row) out << std::setw(6) << itot(t);
@@ -232,11 +254,11 @@ public:
 			}
 			out << std::endl;
 		}
-		out << "+------------------------+" << std::endl;
+		out << "+" << std::string(W * 6, '-') << "+" << std::endl;
 		return out;
 	}
-	friend std::istream& operator >>(std::istream& in, board& b) {
-		for (int i = 0; i < 16; i++) {
+	friend std::istream& operator >>(std::istream& in, basic_board& b) {
+		for (unsigned i = 0; i < cells; i++) {
 			while (!std::isdigit(in.peek()) && in.good()) in.ignore(1);
 			in >> b(i);
 			b(i) = ttoi(b(i));
@@ -249,3 +271,12 @@ private:
 	data attr; // (#3-tile:4-bit) (#2-tile:4-bit) (#1-tile:4-bit) (last_action:4-bit) (hint_tile:4-bit)
 	int merge_count;
 };
+
+template<unsigned W, unsigned H> constexpr unsigned basic_board<W, H>::width;
+template<unsigned W, unsigned H> constexpr unsigned basic_board<W, H>::height;
+template<unsigned W, unsigned H> constexpr unsigned basic_board<W, H>::cells;
+
+/**
+ * the board of the standard game
+ */
+typedef basic_board<4, 4> board;
@@ -0,0 +1,274 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * compact.h: Feature visit counts and compacted lookup tables for n-tuple networks
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <stdexcept>
+#include "weight.h"
+
+/**
+ * visit counts of the features of each table, i.e., how many times each entry is updated
+ * the counts saturate at 2^32 - 1, and are incremented atomically, so the forks of a player
+ * training in parallel can share a counter
+ *
+ * the file starts with "TPVC", uint32 number of tables, followed by uint64 size and uint32 counts of each table
+ */
+class feature_counter {
+public:
+	/**
+	 * the counts of the entries of a table
+	 */
+	class table {
+	public:
+		table(size_t length = 0) : count(new std::atomic<uint32_t>[length]()), length(length) {}
+		uint32_t operator[](size_t i) const { return count[i].load(std::memory_order_relaxed); }
+		size_t size() const { return length; }
+
+	private:
+		friend class feature_counter;
+		std::unique_ptr<std::atomic<uint32_t>[]> count;
+		size_t length;
+	};
+
+public:
+	feature_counter() {}
+
+	/**
+	 * whether the counts are of the tables of the network, i.e., have the same number and sizes of tables
+	 */
+	bool match(const std::vector<weight>& net) const {
+		if (counts.size() != net.size()) return false;
+		for (size_t i = 0; i < net.size(); i++)
+			if (counts[i].size() != net[i].size()) return false;
+		return true;
+	}
+	/**
+	 * discard the counts, and count the features of the network from zero
+	 */
+	void reset(const std::vector<weight>& net) {
+		counts.clear();
+		for (const weight& w : net) counts.emplace_back(w.size());
+	}
+	void touch(size_t i, size_t index) {
+		std::atomic<uint32_t>& c = counts[i].count[index];
+		uint32_t v = c.load(std::memory_order_relaxed);
+		while (v != uint32_t(-1) && !c.compare_exchange_weak(v, v + 1, std::memory_order_relaxed));
+	}
+	size_t size() const { return counts.size(); }
+	const table& operator[](size_t i) const { return counts[i]; }
+
+	bool load(const std::string& path) {
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		char magic[4] = {};
+		uint32_t size = 0;
+		if (!in.read(magic, 4) || std::memcmp(magic, "TPVC", 4)) return false;
+		in.read(reinterpret_cast<char*>(&size), sizeof(size));
+		counts.clear();
+		std::vector<uint32_t> buf;
+		for (uint32_t i = 0; i < size && in; i++) {
+			uint64_t len = 0;
+			in.read(reinterpret_cast<char*>(&len), sizeof(len));
+			buf.resize(in ? len : 0);
+			in.read(reinterpret_cast<char*>(buf.data()), sizeof(uint32_t) * buf.size());
+			counts.emplace_back(buf.size());
+			for (size_t k = 0; k < buf.size(); k++) counts.back().count[k] = buf[k];
+		}
+		return bool(in);
+	}
+	void save(const std::string& path) const {
+		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) throw std::runtime_error("cannot save visits to " + path);
+		uint32_t size = counts.size();
+		out.write("TPVC", 4);
+		out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		std::vector<uint32_t> buf;
+		for (const table& c : counts) {
+			uint64_t len = c.size();
+			buf.resize(len);
+			for (size_t k = 0; k < len; k++) buf[k] = c[k];
+			out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+			out.write(reinterpret_cast<const char*>(buf.data()), sizeof(uint32_t) * len);
+		}
+	}
+
+private:
+	std::vector<table> counts;
+};
+
+/**
+ * read-only lookup table which stores only the pages containing kept features
+ *
+ * the index space is split into pages of 2^page_bits entries, the page directory maps each page
+ * to its stored copy, and every dropped page is mapped to the shared zero page, so a lookup is
+ * value[page[i >> page_bits] << page_bits | (i & page_mask)] with a directory small enough for the cache
+ */
+class compact_weight {
+public:
+	static const unsigned page_bits = 8;
+	static const size_t page_size = size_t(1) << page_bits;
+	static const size_t page_mask = page_size - 1;
+
+public:
+	compact_weight() : length(0) {}
+
+	/**
+	 * compact a table, where a feature is kept if it is visited at least 'min' times,
+	 * or if its weight is nonzero when no visit counts are given
+	 */
+	compact_weight(const weight& w, const feature_counter::table* visits = nullptr, uint32_t min = 1)
+		: length(w.size()), kept(0) {
+		page.assign((length + page_mask) >> page_bits, 0);
+		value.assign(page_size, 0); // the zero page
+		for (size_t p = 0; p < page.size(); p++) {
+			size_t begin = p << page_bits, end = std::min(begin + page_size, length);
+			size_t hit = 0;
+			for (size_t i = begin; i < end; i++)
+				hit += visits ? (*visits)[i] >= min : w[i] != 0;
+			if (hit == 0) continue;
+			kept += hit;
+			page[p] = value.size() >> page_bits;
+			for (size_t i = begin; i < begin + page_size; i++) {
+				bool keep = i < end && (visits ? (*visits)[i] >= min : true);
+				value.push_back(keep ? w[i] : 0);
+			}
+		}
+	}
+
+	weight::type operator[] (size_t i) const {
+		return value[(size_t(page[i >> page_bits]) << page_bits) | (i & page_mask)];
+	}
+	size_t size() const { return length; }
+	size_t features() const { return kept; }
+	size_t pages() const { return page.size(); }
+	size_t stored_pages() const { return (value.size() >> page_bits) - 1; }
+	size_t bytes() const { return page.size() * sizeof(uint32_t) + value.size() * sizeof(weight::type); }
+
+public:
+	friend std::ostream& operator <<(std::ostream& out, const compact_weight& w) {
+		uint64_t len = w.length, kept = w.kept, pages = w.page.size(), size = w.value.size();
+		out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+		out.write(reinterpret_cast<const char*>(&kept), sizeof(kept));
+		out.write(reinterpret_cast<const char*>(&pages), sizeof(pages));
+		out.write(reinterpret_cast<const char*>(w.page.data()), sizeof(uint32_t) * pages);
+		out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		out.write(reinterpret_cast<const char*>(w.value.data()), sizeof(weight::type) * size);
+		return out;
+	}
+	friend std::istream& operator >>(std::istream& in, compact_weight& w) {
+		uint64_t len = 0, kept = 0, pages = 0, size = 0;
+		in.read(reinterpret_cast<char*>(&len), sizeof(len));
+		in.read(reinterpret_cast<char*>(&kept), sizeof(kept));
+		in.read(reinterpret_cast<char*>(&pages), sizeof(pages));
+		w.page.resize(pages);
+		in.read(reinterpret_cast<char*>(w.page.data()), sizeof(uint32_t) * pages);
+		in.read(reinterpret_cast<char*>(&size), sizeof(size));
+		w.value.resize(size);
+		in.read(reinterpret_cast<char*>(w.value.data()), sizeof(weight::type) * size);
+		w.length = len, w.kept = kept;
+		return in;
+	}
+
+private:
+	uint64_t length;
+	uint64_t kept;
+	std::vector<uint32_t> page;
+	std::vector<weight::type> value; // value[0, page_size) is the zero page
+};
+
+/**
+ * compact a trained network offline, and report the coverage of each table
+ *
+ * the compacted file starts with "TPCK", uint32 number of tables, followed by the compacted tables,
+ * which can be loaded by the tuple player for evaluation, e.g., --slide="load=compact.bin alpha=0"
+ *
+ * the arguments are given as "key=value" pairs, e.g., "load=weights.bin visits=visits.bin min=1 save=compact.bin"
+ *  'load': the path of the network
+ *  'visits': the path of the visit counts recorded in training (optional)
+ *  'min': the minimum visit count of a kept feature (default 1)
+ *  'save': the path of the compacted network (optional)
+ */
+class compactor {
+public:
+	compactor(const std::string& args = "") : min(1) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "load") load_path = value;
+			else if (key == "visits") visits_path = value;
+			else if (key == "min") min = std::stoul(value);
+			else if (key == "save") save_path = value;
+			else throw std::invalid_argument("invalid compact argument: " + pair);
+		}
+		if (load_path.empty()) throw std::invalid_argument("no network to compact");
+	}
+
+	/**
+	 * compact the network and print the report
+	 *
+	 * the format is
+	 * table   features        kept    coverage        pages   memory
+	 * 0       16777216        123456  0.74%   4321/65536      4.38MB
+	 * total   134217728       987654  0.74%   34567/524288    35.1MB (512MB)
+	 */
+	void run(std::ostream& out = std::cout) const {
+		std::ifstream in(load_path, std::ios::in | std::ios::binary);
+		if (!in.is_open()) throw std::runtime_error("cannot load network from " + load_path);
+		uint32_t size = 0;
+		in.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+		feature_counter visits;
+		if (visits_path.size() && !visits.load(visits_path))
+			throw std::runtime_error("cannot load visits from " + visits_path);
+		if (visits_path.size() && visits.size() != size)
+			throw std::runtime_error("mismatched visits " + visits_path);
+
+		std::ofstream save;
+		if (save_path.size()) {
+			save.open(save_path, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!save.is_open()) throw std::runtime_error("cannot save network to " + save_path);
+			save.write("TPCK", 4);
+			save.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		}
+
+		std::ios ff(nullptr);
+		ff.copyfmt(out);
+		out << std::fixed << std::setprecision(2);
+		out << "table\t" "features\t" "kept\t" "coverage\t" "pages\t" "memory" << std::endl;
+		uint64_t features = 0, kept = 0, pages = 0, stored = 0, bytes = 0, origin = 0;
+		for (uint32_t i = 0; i < size; i++) {
+			weight w;
+			in >> w; // one table at a time, so that the whole network is never in memory
+			if (visits_path.size() && visits[i].size() != w.size())
+				throw std::runtime_error("mismatched visits " + visits_path);
+			compact_weight c(w, visits_path.size() ? &visits[i] : nullptr, min);
+			if (save.is_open()) save << c;
+			out << i << "\t" << c.size() << "\t" << c.features() << "\t" << (c.features() * 100.0 / c.size()) << "%\t";
+			out << c.stored_pages() << "/" << c.pages() << "\t" << (c.bytes() / 1048576.0) << "MB" << std::endl;
+			features += c.size(), kept += c.features();
+			pages += c.pages(), stored += c.stored_pages();
+			bytes += c.bytes(), origin += w.size() * sizeof(weight::type);
+		}
+		out << "total\t" << features << "\t" << kept << "\t" << (features ? kept * 100.0 / features : 0) << "%\t";
+		out << stored << "/" << pages << "\t" << (bytes / 1048576.0) << "MB (" << (origin / 1048576.0) << "MB)" << std::endl;
+		out.copyfmt(ff);
+	}
+
+private:
+	std::string load_path, visits_path, save_path;
+	uint32_t min;
+};
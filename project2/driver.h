@@ -0,0 +1,67 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * driver.h: Game loop of concrete agent types
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "alloc.h"
+
+/**
+ * the game loop of a slider and a placer of known types, e.g., game_driver<tuple_player, random_placer>,
+ * which plays the same games as the loop of agent& in threes.cpp
+ *
+ * the calls to the agents are qualified by their types, so that they are bound at compile time and
+ * can be inlined instead of being dispatched through the virtual table of agent, and the names of
+ * the agents are looked up once instead of from the properties of every episode
+ * note that the types must be the exact types of the agents, since a qualified call skips any override
+ */
+template<class slider, class placer>
+class game_driver {
+public:
+	game_driver(slider& slide, placer& place) : slide(slide), place(place),
+		slide_name(slide.slider::name()), place_name(place.placer::name()) {}
+
+public:
+	/**
+	 * play a game from the beginning of 'game'
+	 */
+	void run(episode& game) {
+		slide.slider::open_episode("~:" + place_name);
+		place.placer::open_episode(slide_name + ":~");
+
+		game.open_episode(slide_name + ":" + place_name);
+		while (game.take_slide_turn() ? take_turn(game, slide, allocation::slide) : take_turn(game, place, allocation::place));
+		const std::string& win = game.last_slide_turn() ? slide_name : place_name;
+		game.close_episode(win);
+
+		allocation::scope phase(allocation::train);
+		slide.slider::close_episode(win);
+		place.placer::close_episode(win);
+	}
+
+private:
+	/**
+	 * let the agent make a move, return false if the game is over
+	 */
+	template<class who>
+	static bool take_turn(episode& game, who& player, allocation::phase p) {
+		allocation::scope phase(p);
+		action move = player.who::take_action(game.state());
+		if (game.apply_action(move) != true) return false;
+		return !player.who::check_for_win(game.state());
+	}
+
+private:
+	slider& slide;
+	placer& place;
+	std::string slide_name, place_name;
+};
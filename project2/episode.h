@@ -18,21 +18,29 @@
 #include "board.h"
 #include "action.h"
 #include "agent.h"
+#include "alloc.h"
 
 class episode {
 public:
-	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) { ep_moves.reserve(10000); }
+	episode() : ep_state(initial_state()), ep_score(0), ep_time(0), ep_alloc() { ep_moves.reserve(10000); }
 
 public:
 	board& state() { return ep_state; }
 	const board& state() const { return ep_state; }
 	board::score score() const { return ep_score; }
 
+	/**
+	 * the heap allocations of the thread between open_episode and close_episode, if --alloc is enabled
+	 */
+	allocation::counter allocs() const { return ep_alloc; }
+
 	void open_episode(const std::string& tag) {
 		ep_open = { tag, millisec() };
+		ep_alloc = allocation::current();
 	}
 	void close_episode(const std::string& tag) {
 		ep_close = { tag, millisec() };
+		ep_alloc = allocation::current() - ep_alloc;
 	}
 	bool apply_action(action move) {
 		board::reward reward = move.apply(state());
@@ -42,11 +50,23 @@ public:
 		return true;
 	}
 	agent& take_turns(agent& slide, agent& place) {
-		ep_time = millisec();
-		return step() >= 9 && (step() - 8) % 2 ? slide : place;
+		return take_slide_turn() ? slide : place;
 	}
 	agent& last_turns(agent& slide, agent& place) {
-		return step() >= 9 ? take_turns(place, slide) : place;
+		return last_slide_turn() ? slide : place;
+	}
+
+	/**
+	 * the turns without the agents, e.g., for a loop of concrete agent types, see driver.h
+	 * take_slide_turn starts the timer of the next move and returns whether the slider makes it,
+	 * and last_slide_turn returns whether the slider made the last move
+	 */
+	bool take_slide_turn() {
+		ep_time = millisec();
+		return step() >= 9 && (step() - 8) % 2;
+	}
+	bool last_slide_turn() const {
+		return step() >= 9 && (step() - 8) % 2 == 0;
 	}
 
 public:
@@ -178,6 +198,7 @@ private:
 	board::score ep_score;
 	std::vector<move> ep_moves;
 	time_t ep_time;
+	allocation::counter ep_alloc;
 
 	meta ep_open;
 	meta ep_close;
@@ -0,0 +1,259 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * expectimax.h: Parallel expectimax search with a shared lock-free transposition table
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <algorithm>
+#include "board.h"
+#include "batch.h"
+#include "thread_pool.h"
+
+/**
+ * lock-free transposition table of afterstate values
+ *
+ * each entry stores (key ^ data, data) in two atomic words, so a torn entry written by
+ * two threads at once fails the check and is treated as a miss instead of a wrong value
+ * the data holds the value, the search depth, and the generation of the value function,
+ * and entries of an older generation are ignored, e.g., after the weights are trained
+ */
+class transposition_table {
+public:
+	transposition_table(unsigned bits = 20) : table(new entry[size_t(1) << bits]()), mask((size_t(1) << bits) - 1), age(0) {}
+
+	template<class board_t>
+	bool probe(const board_t& b, unsigned depth, float& value) const {
+		uint64_t key = hash(b);
+		const entry& e = table[key & mask];
+		uint64_t data = e.data.load(std::memory_order_relaxed);
+		uint64_t check = e.check.load(std::memory_order_relaxed);
+		if ((check ^ data) != key) return false;
+		if (((data >> 32) & 0xff) < depth || (data >> 40) != (age.load(std::memory_order_relaxed) & 0xffff)) return false;
+		uint32_t bits = uint32_t(data);
+		std::memcpy(&value, &bits, sizeof(value));
+		return true;
+	}
+
+	template<class board_t>
+	void store(const board_t& b, unsigned depth, float value) {
+		uint64_t key = hash(b);
+		entry& e = table[key & mask];
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint64_t data = bits | (uint64_t(std::min(depth, 0xffu)) << 32) | (uint64_t(age.load(std::memory_order_relaxed) & 0xffff) << 40);
+		e.check.store(key ^ data, std::memory_order_relaxed);
+		e.data.store(data, std::memory_order_relaxed);
+	}
+
+	/**
+	 * invalidate all stored values, which should be called once the value function is changed
+	 */
+	void advance() { age++; }
+
+private:
+	/**
+	 * the tiles of the first 16 cells are packed into a word, and those of a larger board are mixed in
+	 */
+	template<class board_t>
+	static uint64_t hash(const board_t& b) {
+		uint64_t tiles = 0;
+		for (unsigned i = 0; i < std::min(board_t::cells, 16u); i++) tiles |= uint64_t(b(i) & 0x0f) << (4 * i);
+		for (unsigned i = 16; i < board_t::cells; i++) tiles = (tiles ^ b(i)) * 0x100000001b3ull;
+		uint64_t h = tiles ^ (b.info() * 0x9e3779b97f4a7c15ull);
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull; // splitmix64 finalizer
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+		return h ^ (h >> 31);
+	}
+
+private:
+	struct entry {
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> data;
+	};
+	std::unique_ptr<entry[]> table;
+	size_t mask;
+	std::atomic<unsigned> age;
+};
+
+/**
+ * depth-limited expectimax over the slides of the player and the placements of the environment
+ *
+ * a depth of d searches d slides, where the afterstates of the last slides are evaluated by the
+ * value function, so a depth of 1 is the same as the greedy afterstate selection
+ * a chance node averages over every empty position of the edge opposite to the last slide and
+ * every possible next hint weighted by the bag, since the placed tile is the current hint
+ *
+ * the search is iteratively deepened until the depth or the deadline is reached, and the result of
+ * the deepest complete iteration is used; the first 'split' plies from the root, i.e., root moves
+ * and chance outcomes, are expanded as tasks on the global thread pool
+ * expectimax is of the standard board, and basic_expectimax of a board of the given geometry
+ */
+template<class board_t>
+class basic_expectimax {
+public:
+	typedef std::function<float(const board_t&)> evaluator;
+
+	basic_expectimax(evaluator eval, unsigned depth = 1, unsigned timeout = 0, unsigned split = 2, unsigned bits = 20)
+		: eval(eval), table(std::make_shared<transposition_table>(bits)),
+		  depth(std::max(depth, 1u)), timeout(timeout), split(split), expired(false) {}
+
+	/**
+	 * create a search with the same settings and the same table, but another value function
+	 */
+	basic_expectimax(const basic_expectimax& origin, evaluator eval)
+		: eval(eval), table(origin.table),
+		  depth(origin.depth), timeout(origin.timeout), split(origin.split), expired(false) {}
+
+	/**
+	 * return the opcode of the best slide, or -1 if there is no legal slide
+	 */
+	int search(const board_t& before) {
+		deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		expired = false;
+		int best = -1;
+		for (unsigned d = 1; d <= depth; d++) {
+			int op = root(before, d);
+			if (expired) break; // discard the incomplete iteration
+			best = op;
+		}
+		return best;
+	}
+
+	transposition_table& cache() { return *table; }
+
+private:
+	int root(const board_t& before, unsigned d) {
+		board_t after[4];
+		float value[4];
+		int reward[4];
+		thread_pool::task_group group;
+		for (int op = 0; op < 4; op++) {
+			after[op] = before;
+			reward[op] = after[op].slide(op);
+			if (reward[op] == -1) continue;
+			auto task = [&, op]() { value[op] = reward[op] + expect(after[op], d - 1, 1); };
+			if (split > 0) group.run(task);
+			else task();
+		}
+		group.wait();
+		int best = -1;
+		for (int op = 0; op < 4; op++) {
+			if (reward[op] != -1 && (best == -1 || value[op] > value[best])) best = op;
+		}
+		return best;
+	}
+
+	/**
+	 * the value of a decision node, i.e., the best slide reward plus the afterstate value
+	 */
+	float decide(const board_t& before, unsigned d, unsigned ply) {
+		float best = 0;
+		bool moved = false;
+		for (int op = 0; op < 4; op++) {
+			board_t after = before;
+			int reward = after.slide(op);
+			if (reward == -1) continue;
+			float value = reward + expect(after, d - 1, ply + 1);
+			if (!moved || value > best) best = value;
+			moved = true;
+		}
+		return best; // a terminal state is worth nothing
+	}
+
+	/**
+	 * the value of an afterstate, i.e., the expected value of the decision nodes after the placements
+	 */
+	float expect(const board_t& after, unsigned d, unsigned ply) {
+		if (d == 0 || after.hint() == 0) return eval(after);
+		if (is_expired()) return 0;
+		float cached;
+		if (table->probe(after, d, cached)) return cached;
+
+		std::vector<board_t> child;
+		std::vector<unsigned> weight;
+		for (unsigned i = 0; i < board_t::edges(after.last()); i++) {
+			unsigned pos = board_t::edge(after.last(), i);
+			if (after(pos) != 0) continue;
+			for (typename board_t::cell t = 1; t <= 3; t++) {
+				if (after.bag(t) == 0) continue;
+				child.push_back(after);
+				child.back().place(pos, after.hint(), t);
+				weight.push_back(after.bag(t));
+			}
+		}
+		if (child.empty()) return eval(after);
+
+		std::vector<float> value(child.size());
+		if (d == 1) {
+			decide_leaves(child, value);
+		} else if (ply < split) {
+			thread_pool::task_group group;
+			for (size_t i = 0; i < child.size(); i++)
+				group.run([&, i]() { value[i] = decide(child[i], d, ply + 1); });
+			group.wait();
+		} else {
+			for (size_t i = 0; i < child.size(); i++)
+				value[i] = decide(child[i], d, ply + 1);
+		}
+		float sum = 0, total = 0;
+		for (size_t i = 0; i < child.size(); i++) {
+			sum += value[i] * weight[i];
+			total += weight[i];
+		}
+		float result = sum / total;
+		if (!is_expired()) table->store(after, d, result);
+		return result;
+	}
+
+	/**
+	 * the values of decision nodes whose afterstates are all leaves, where the slides are
+	 * batched into a board_batch so that the boards are slid together in each direction
+	 */
+	void decide_leaves(const std::vector<board_t>& child, std::vector<float>& value) {
+		for (size_t base = 0; base < child.size(); base += 16) {
+			board_batch<16, board_t> before;
+			for (size_t i = base; i < std::min(base + 16, child.size()); i++) before.push(child[i]);
+			std::fill(value.begin() + base, value.begin() + base + before.size(), 0);
+			bool moved[16] = {};
+			for (int op = 0; op < 4; op++) {
+				board_batch<16, board_t> after = before;
+				typename board_t::reward reward[16];
+				after.slide(op, reward);
+				for (size_t k = 0; k < before.size(); k++) {
+					if (reward[k] == -1) continue;
+					float v = reward[k] + eval(after.get(k));
+					if (!moved[k] || v > value[base + k]) value[base + k] = v;
+					moved[k] = true;
+				}
+			}
+		}
+	}
+
+	bool is_expired() {
+		if (timeout == 0) return false;
+		if (!expired.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() > deadline)
+			expired = true;
+		return expired.load(std::memory_order_relaxed);
+	}
+
+private:
+	evaluator eval;
+	std::shared_ptr<transposition_table> table;
+	unsigned depth;
+	unsigned timeout;
+	unsigned split;
+	std::atomic<bool> expired;
+	std::chrono::steady_clock::time_point deadline;
+};
+
+typedef basic_expectimax<board> expectimax;
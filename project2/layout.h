@@ -0,0 +1,125 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * layout.h: Index layouts of tuple features and the converter between them
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include "weight.h"
+
+/**
+ * the mapping from the six 4-bit tiles of a feature to the index in a table
+ *
+ * 'base16':     the tiles as a base-16 number, t0 is the most significant digit (the original layout)
+ * 'interleave': the tiles bit-plane by bit-plane, i.e., bit p of tile k is at bit 6 * p + (5 - k),
+ *               so every feature of tiles below 2^p lies in the first 2^(6p) entries, e.g., the
+ *               features of tiles up to 24 (index 7) share the first 1MB of a float table
+ *               instead of being spread over the whole 64MB
+ */
+class index_layout {
+public:
+	enum type { base16, interleave };
+
+	static type parse(const std::string& name) {
+		if (name == "base16") return base16;
+		if (name == "interleave") return interleave;
+		throw std::invalid_argument("invalid index layout: " + name);
+	}
+
+	static uint32_t encode(type layout, const unsigned t[6]) {
+		if (layout == interleave) {
+			return (spread(t[0]) << 5) | (spread(t[1]) << 4) | (spread(t[2]) << 3)
+				| (spread(t[3]) << 2) | (spread(t[4]) << 1) | spread(t[5]);
+		}
+		return (t[0] << 20) | (t[1] << 16) | (t[2] << 12) | (t[3] << 8) | (t[4] << 4) | t[5];
+	}
+
+	static void decode(type layout, uint32_t index, unsigned t[6]) {
+		for (int k = 0; k < 6; k++) {
+			if (layout == interleave) {
+				t[k] = 0;
+				for (int p = 0; p < 4; p++) t[k] |= ((index >> (6 * p + 5 - k)) & 1) << p;
+			} else {
+				t[k] = (index >> (4 * (5 - k))) & 0x0f;
+			}
+		}
+	}
+
+	/**
+	 * the bits of a tile spread to the bit positions 0, 6, 12, 18
+	 */
+	static uint32_t spread(unsigned tile) {
+		static const uint32_t table[16] = {
+			0x00000, 0x00001, 0x00040, 0x00041, 0x01000, 0x01001, 0x01040, 0x01041,
+			0x40000, 0x40001, 0x40040, 0x40041, 0x41000, 0x41001, 0x41040, 0x41041,
+		};
+		return table[tile & 0x0f];
+	}
+};
+
+/**
+ * convert a network between index layouts offline
+ * note that a weight file does not record its layout, so the layout must be given to the player,
+ * e.g., --slide="load=weights.bin layout=interleave"
+ *
+ * the arguments are given as "key=value" pairs, e.g., "load=weights.bin from=base16 to=interleave save=new.bin"
+ *  'load': the path of the network
+ *  'from': the layout of the network (default base16)
+ *  'to': the layout to convert to (default interleave)
+ *  'save': the path of the converted network
+ */
+class layout_converter {
+public:
+	layout_converter(const std::string& args = "") : from(index_layout::base16), to(index_layout::interleave) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "load") load_path = value;
+			else if (key == "from") from = index_layout::parse(value);
+			else if (key == "to") to = index_layout::parse(value);
+			else if (key == "save") save_path = value;
+			else throw std::invalid_argument("invalid convert argument: " + pair);
+		}
+		if (load_path.empty() || save_path.empty()) throw std::invalid_argument("convert needs both load and save");
+	}
+
+	/**
+	 * convert the network table by table, only 6-tuple tables (2^24 entries) can be converted
+	 */
+	void run(std::ostream& out = std::cout) const {
+		std::ifstream in(load_path, std::ios::in | std::ios::binary);
+		if (!in.is_open()) throw std::runtime_error("cannot load network from " + load_path);
+		std::ofstream save(save_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!save.is_open()) throw std::runtime_error("cannot save network to " + save_path);
+		uint32_t size = 0;
+		in.read(reinterpret_cast<char*>(&size), sizeof(size));
+		save.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		for (uint32_t i = 0; i < size; i++) {
+			weight w, v;
+			in >> w;
+			if (w.size() != (1u << 24)) throw std::runtime_error("table " + std::to_string(i) + " is not of a 6-tuple");
+			v = weight(w.size());
+			for (uint32_t index = 0; index < w.size(); index++) {
+				unsigned t[6];
+				index_layout::decode(from, index, t);
+				v[index_layout::encode(to, t)] = w[index];
+			}
+			save << v;
+		}
+		out << "convert\t" << size << " tables from " << load_path << " to " << save_path << std::endl;
+	}
+
+private:
+	std::string load_path, save_path;
+	index_layout::type from, to;
+};
@@ -0,0 +1,160 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * pattern.h: Tuple patterns of the n-tuple network for each board geometry
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <utility>
+#include "board.h"
+
+/**
+ * the 6-tuple patterns of a board, grouped by tables, i.e., pattern i is looked up in table i / isomorphisms
+ *
+ * the patterns of a geometry are generated from the 2x3 rectangles whose corners lie in the top-left
+ * quarter of the board, where each rectangle is a table, and its isomorphisms are the images of the
+ * rectangle under the symmetries of the board, i.e., 8 for a square board and 4 for the others
+ * e.g., 3x3 has 1 table, and 5x5 has 4 tables, of 16^6 entries each
+ *
+ * the standard 4x4 board keeps its tuned patterns of 8 tables, see the specialization below
+ */
+template<class board_t>
+class tuple_patterns {
+	static constexpr unsigned W = board_t::width;
+	static constexpr unsigned H = board_t::height;
+	static_assert(W >= 3 && H >= 2, "a 2x3 rectangle must fit into the board");
+
+public:
+	static constexpr unsigned isomorphisms = W == H ? 8 : 4;
+	static constexpr unsigned rows = H / 2, cols = (W - 1) / 2; // the corners in the top-left quarter
+	static constexpr unsigned tuples = rows * cols;
+	static constexpr unsigned count = tuples * isomorphisms;
+
+	/**
+	 * the cell indices of the patterns, generated once from the geometry
+	 */
+	static const int (&index())[count][6] {
+		struct table_t {
+			int cell[count][6];
+			table_t() {
+				unsigned n = 0;
+				for (unsigned r = 0; r < rows; r++) {
+					for (unsigned c = 0; c < cols; c++) {
+						for (unsigned s = 0; s < isomorphisms; s++, n++) {
+							for (unsigned k = 0; k < 6; k++)
+								cell[n][k] = image(s, r + k / 3, c + k % 3);
+						}
+					}
+				}
+			}
+		};
+		static const table_t table;
+		return table.cell;
+	}
+
+private:
+	/**
+	 * the index of cell (r, c) under symmetry s, where s = 4, ..., 7 transposes a square board first
+	 */
+	static int image(unsigned s, unsigned r, unsigned c) {
+		if (s >= 4) std::swap(r, c);
+		if (s & 1) c = W - 1 - c;
+		if (s & 2) r = H - 1 - r;
+		return r * W + c;
+	}
+};
+
+/**
+ * the patterns of the standard board, where each of the 8 tables has 8 hand-picked patterns
+ */
+template<>
+class tuple_patterns<basic_board<4, 4>> {
+public:
+	static constexpr unsigned isomorphisms = 8;
+	static constexpr unsigned tuples = 8;
+	static constexpr unsigned count = tuples * isomorphisms;
+
+	static const int (&index())[count][6] {
+		//0 1 2 3
+		//4 5 6 7
+		//8 9 10 11
+		//12 13 14 15
+		static const int network_index[count][6]={
+			{0,1,2,4,5,6},
+			{2,3,6,7,10,11},
+			{9,10,11,13,14,15},
+			{4,5,8,9,12,13},
+			{8,9,10,12,13,14},
+			{0,1,4,5,8,9},
+			{1,2,3,5,6,7},
+			{6,7,10,11,14,15},
+
+			{1,2,5,6,9,13},
+			{4,5,6,7,10,11},
+			{2,6,10,14,13,9},
+			{4,5,8,9,10,11},
+			{1,2,5,6,10,14},
+			{6,7,8,9,10,11},
+			{1,5,9,10,13,14},
+			{4,5,6,7,8,9},
+
+			{0,1,2,3,4,5},
+			{2,6,3,7,11,15},
+			{12,13,14,15,10,11},
+			{0,4,8,12,9,13},
+			{8,9,12,13,14,15},
+			{0,1,4,5,8,12},
+			{0,1,2,3,6,7},
+			{3,7,10,11,14,15},
+
+			{0,1,6,7,8,11},
+			{3,7,6,9,10,14,},
+			{5,8,9,10,15},
+			{1,5,6,8,9,12},
+			{6,9,10,11,12,13},
+			{0,4,5,9,10,13},
+			{2,3,4,5,6,9},
+			{2,5,6,10,11,15},
+
+			{0,1,2,5,9,10},
+			{3,5,6,7,9,11},
+			{5,6,10,13,14,15},
+			{4,6,8,9,10,12},
+			{5,6,9,12,13,14},
+			{0,4,5,6,8,10},
+			{1,2,3,6,9,10},
+			{5,7,9,10,11,15},
+
+			{0,1,5,9,13,14},
+			{3,4,5,6,7,8},
+			{1,2,6,10,14,15},
+			{7,8,9,10,11,12},
+			{1,2,5,9,12,13},
+			{0,4,5,6,7,11},
+			{2,3,6,10,13,14},
+			{4,8,9,10,11,15},
+
+			{0,1,5,8,9,13},
+			{1,3,4,5,6,7},
+			{2,6,7,10,14,15},
+			{8,9,10,11,12,14},
+			{1,4,5,9,12,13},
+			{0,2,4,5,6,7},
+			{2,3,6,10,11,14},
+			{8,9,10,11,13,15},
+
+			{0,1,2,4,6,10},
+			{2,3,7,9,10,11},
+			{5,9,11,13,14,15},
+			{4,5,6,8,12,13},
+			{2,6,8,10,12,14},
+			{0,1,4,8,9,10},
+			{1,2,3,5,7,9},
+			{5,6,7,11,14,15}
+		};
+		return network_index;
+	}
+};
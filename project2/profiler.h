@@ -0,0 +1,219 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * profiler.h: In-process sampling profiler with folded-stack output
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/**
+ * sample the call stacks of all threads by SIGPROF, i.e., every 1/hz second of CPU time of the process,
+ * and write them as folded stacks, one line per distinct stack from the root, e.g.,
+ * main;tuple_player::take_action(board const&);tuple_player::evaluate_score(board&) 1234
+ * which is the input of flamegraph.pl, speedscope, etc.
+ *
+ * the signal handler only walks the stack by backtrace (the unwinder of libgcc, warmed up beforehand so
+ * that it does not allocate in the handler) into a fixed ring of samples, which a background thread drains
+ * into the counts of stacks; the stacks are written at exit, and whenever SIGUSR1 is received
+ * the names are resolved by dladdr, so link with -rdynamic for the names of the functions of the program,
+ * or the frames are written as module+offset, e.g., threes+0x1a2b, which addr2line resolves
+ *
+ * the arguments are given as "key=value" pairs, e.g., "save=profile.folded hz=999"
+ *  'save': the path of the folded stacks (default profile.folded)
+ *  'hz': the sampling frequency in CPU time (default 999)
+ */
+class profiler {
+public:
+	profiler(const std::string& args = "") : path("profile.folded"), hz(999), ring(new slot[capacity]),
+		head(0), tail(0), dropped(0), running(true) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "save") path = value;
+			else if (key == "hz") hz = std::stoul(value);
+			else throw std::invalid_argument("invalid profile argument: " + pair);
+		}
+		if (hz == 0 || hz > 100000) throw std::invalid_argument("invalid profile frequency: " + std::to_string(hz));
+		if (active().exchange(this)) throw std::logic_error("only one profiler can run at a time");
+
+		void* warm[max_depth];
+		backtrace(warm, max_depth); // load the unwinder before the first signal
+		for (size_t i = 0; i < capacity; i++) ring[i].ready = 0;
+
+		drain = std::thread([this]() {
+			sigset_t mask; // never sample the drain itself
+			sigemptyset(&mask);
+			sigaddset(&mask, SIGPROF);
+			sigaddset(&mask, SIGUSR1);
+			pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+			while (running) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				collect();
+				if (requested().exchange(0)) save();
+			}
+		});
+
+		std::signal(SIGUSR1, [](int) { requested() = 1; });
+		std::signal(SIGPROF, handler);
+		long usec = 1000000 / hz;
+		itimerval timer = { { usec / 1000000, usec % 1000000 }, { usec / 1000000, usec % 1000000 } };
+		setitimer(ITIMER_PROF, &timer, nullptr);
+	}
+
+	/**
+	 * stop sampling and write the profile
+	 */
+	~profiler() {
+		itimerval timer = {};
+		setitimer(ITIMER_PROF, &timer, nullptr);
+		std::signal(SIGPROF, SIG_IGN);
+		std::signal(SIGUSR1, SIG_DFL);
+		running = false;
+		drain.join();
+		collect();
+		save();
+		active() = nullptr;
+	}
+
+private:
+	static const size_t max_depth = 64;
+	static const size_t capacity = 4096; // the samples not drained yet, i.e., 0.05 second of 80 busy threads
+	static const int skip = 2; // the frames of the handler and the signal trampoline
+
+	struct slot {
+		std::atomic<uint64_t> ready; // the sequence number + 1 of the sample, once written
+		int depth;
+		void* frame[max_depth];
+	};
+
+	static std::atomic<profiler*>& active() {
+		static std::atomic<profiler*> instance(nullptr);
+		return instance;
+	}
+	static std::atomic<int>& requested() {
+		static std::atomic<int> flag(0);
+		return flag;
+	}
+
+	static void handler(int) {
+		int saved = errno;
+		profiler* p = active().load(std::memory_order_acquire);
+		if (p) p->sample();
+		errno = saved;
+	}
+
+	/**
+	 * record the stack of the interrupted thread, or drop it if the ring is full
+	 */
+	void sample() {
+		uint64_t h = head.load(std::memory_order_relaxed);
+		do {
+			if (h - tail.load(std::memory_order_acquire) >= capacity) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		} while (!head.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel));
+		slot& s = ring[h % capacity];
+		s.depth = backtrace(s.frame, max_depth);
+		s.ready.store(h + 1, std::memory_order_release);
+	}
+
+	/**
+	 * move the written samples from the ring into the counts of stacks, from the root to the leaf
+	 */
+	void collect() {
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		for (slot* s = &ring[t % capacity]; s->ready.load(std::memory_order_acquire) == t + 1; s = &ring[t % capacity]) {
+			std::vector<void*> stack;
+			for (int i = s->depth - 1; i >= skip; i--) stack.push_back(s->frame[i]);
+			if (stack.size()) counts[stack]++;
+			tail.store(++t, std::memory_order_release);
+		}
+	}
+
+	/**
+	 * the name of a frame, where a return address is moved back into its call instruction
+	 */
+	std::string symbol(void* pc, bool leaf) {
+		void* addr = static_cast<char*>(pc) - (leaf ? 0 : 1);
+		auto it = names.find(addr);
+		if (it != names.end()) return it->second;
+		std::string name;
+		Dl_info info = {};
+		bool found = dladdr(addr, &info);
+		if (found && info.dli_sname) {
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			name = status == 0 ? demangled : info.dli_sname;
+			std::free(demangled);
+		} else if (found && info.dli_fname) {
+			std::string module = info.dli_fname;
+			std::stringstream ss;
+			ss << module.substr(module.find_last_of('/') + 1) << "+0x" << std::hex;
+			ss << (static_cast<char*>(addr) - static_cast<char*>(info.dli_fbase));
+			name = ss.str();
+		} else {
+			name = "[unknown]";
+		}
+		for (char& ch : name) if (ch == ';') ch = ':'; // ';' separates the frames
+		return names[addr] = name;
+	}
+
+	/**
+	 * write the folded stacks
+	 *
+	 * the format is
+	 * profile 12345 samples (0 dropped) saved to profile.folded
+	 */
+	void save() {
+		std::ofstream out(path, std::ios::out | std::ios::trunc);
+		if (!out.is_open()) {
+			std::cerr << "cannot save profile to " << path << std::endl;
+			return;
+		}
+		std::map<std::string, size_t> folded; // the stacks of different addresses in the same functions are merged
+		size_t total = 0;
+		for (const auto& stack : counts) {
+			std::string line;
+			for (size_t i = 0; i < stack.first.size(); i++)
+				line += (i ? ";" : "") + symbol(stack.first[i], i + 1 == stack.first.size());
+			folded[line] += stack.second;
+			total += stack.second;
+		}
+		for (const auto& stack : folded) out << stack.first << " " << stack.second << std::endl;
+		std::cout << "profile\t" << total << " samples (" << dropped << " dropped) saved to " << path << std::endl;
+	}
+
+private:
+	std::string path;
+	size_t hz;
+	std::unique_ptr<slot[]> ring;
+	std::atomic<uint64_t> head, tail, dropped;
+	std::atomic<bool> running;
+	std::thread drain;
+	std::map<std::vector<void*>, size_t> counts;
+	std::map<void*, std::string> names;
+};
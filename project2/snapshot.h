@@ -0,0 +1,221 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * snapshot.h: Delta-compressed snapshots of n-tuple networks
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "weight.h"
+
+/**
+ * create a snapshot of a network as the sparse difference from a base network, or materialize it
+ *
+ * the snapshot starts with "TPSD", uint32 version (1), uint32 number of tables, float quantization
+ * step (0 if exact), uint64 checksum of the base, followed by each table as uint64 size, uint64 number
+ * of entries, and the entries, where each entry is the varint gap from the previous changed index,
+ * followed by either the new float value (exact), or the zigzag varint of round((new - base) / step)
+ * the entries whose quantized difference is zero are dropped, so a quantized snapshot is lossy
+ * by at most half a step per feature, but the error does not accumulate if every snapshot is taken
+ * from the same full base
+ *
+ * the arguments are given as "key=value" pairs, e.g., "base=base.bin load=weights.bin save=snapshot.bin"
+ *  'base': the path of the base network, i.e., a full weight file
+ *  'load': the path of the network to snapshot, or the snapshot to materialize
+ *  'save': the path of the snapshot, or the materialized network
+ *  'quantize': the quantization step of the differences (default 0, i.e., exact)
+ */
+class snapshot {
+public:
+	snapshot(const std::string& args = "") : step(0) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "base") base_path = value;
+			else if (key == "load") load_path = value;
+			else if (key == "save") save_path = value;
+			else if (key == "quantize") step = std::stof(value);
+			else throw std::invalid_argument("invalid snapshot argument: " + pair);
+		}
+		if (base_path.empty() || load_path.empty() || save_path.empty())
+			throw std::invalid_argument("snapshot needs base, load and save");
+	}
+
+public:
+	/**
+	 * write the difference of the loaded network from the base
+	 *
+	 * the format is
+	 * snapshot        123456 of 134217728 features changed, 1.23MB (512.00MB)
+	 */
+	void create(std::ostream& info = std::cout) const {
+		std::ifstream base = open(base_path), in = open(load_path);
+		uint32_t size = tables(base), other = tables(in);
+		if (size != other) throw std::runtime_error("mismatched networks " + base_path + " and " + load_path);
+		std::ofstream out(save_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) throw std::runtime_error("cannot save snapshot to " + save_path);
+
+		uint32_t version = 1;
+		uint64_t checksum = 0;
+		out.write("TPSD", 4);
+		write(out, version);
+		write(out, size);
+		write(out, step);
+		write(out, checksum); // filled after all tables are read
+
+		uint64_t features = 0, changed = 0;
+		std::string buf;
+		for (uint32_t i = 0; i < size; i++) {
+			weight b, w;
+			base >> b;
+			in >> w;
+			if (b.size() != w.size()) throw std::runtime_error("mismatched table " + std::to_string(i));
+			checksum = hash(b, checksum);
+			buf.clear();
+			uint64_t count = 0, last = 0;
+			for (uint64_t k = 0; k < w.size(); k++) {
+				if (step > 0) {
+					int64_t q = std::llround((double(w[k]) - b[k]) / step);
+					if (q == 0) continue;
+					varint(buf, k - last);
+					varint(buf, uint64_t(q << 1) ^ uint64_t(q >> 63));
+				} else {
+					if (std::memcmp(&w[k], &b[k], sizeof(weight::type)) == 0) continue;
+					varint(buf, k - last);
+					buf.append(reinterpret_cast<const char*>(&w[k]), sizeof(weight::type));
+				}
+				last = k;
+				count++;
+			}
+			uint64_t len = w.size();
+			write(out, len);
+			write(out, count);
+			out.write(buf.data(), buf.size());
+			features += len, changed += count;
+		}
+		uint64_t bytes = out.tellp();
+		out.seekp(16);
+		write(out, checksum);
+
+		std::ios ff(nullptr);
+		ff.copyfmt(info);
+		info << std::fixed << std::setprecision(2);
+		info << "snapshot\t" << changed << " of " << features << " features changed, ";
+		info << (bytes / 1048576.0) << "MB (" << (features * sizeof(weight::type) / 1048576.0) << "MB)" << std::endl;
+		info.copyfmt(ff);
+	}
+
+	/**
+	 * apply the loaded snapshot to the base, and save the full network
+	 */
+	void restore(std::ostream& info = std::cout) const {
+		std::ifstream base = open(base_path), in = open(load_path);
+		char magic[4] = {};
+		uint32_t version = 0, size = 0;
+		float quantum = 0;
+		uint64_t checksum = 0;
+		in.read(magic, 4);
+		read(in, version);
+		read(in, size);
+		read(in, quantum);
+		read(in, checksum);
+		if (std::memcmp(magic, "TPSD", 4) || version != 1) throw std::runtime_error("invalid snapshot " + load_path);
+		if (tables(base) != size) throw std::runtime_error("mismatched base " + base_path);
+		std::ofstream out(save_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) throw std::runtime_error("cannot save network to " + save_path);
+		write(out, size);
+
+		uint64_t verify = 0;
+		for (uint32_t i = 0; i < size; i++) {
+			weight w;
+			base >> w;
+			verify = hash(w, verify);
+			uint64_t len = 0, count = 0, k = 0;
+			read(in, len);
+			read(in, count);
+			if (len != w.size()) throw std::runtime_error("mismatched table " + std::to_string(i));
+			for (uint64_t n = 0; n < count; n++) {
+				k += varint(in);
+				if (k >= len || !in) throw std::runtime_error("corrupted snapshot " + load_path);
+				if (quantum > 0) {
+					uint64_t z = varint(in);
+					int64_t q = int64_t(z >> 1) ^ -int64_t(z & 1);
+					w[k] = w[k] + q * quantum;
+				} else {
+					read(in, w[k]);
+				}
+			}
+			out << w;
+		}
+		if (verify != checksum) {
+			out.close();
+			std::remove(save_path.c_str());
+			throw std::runtime_error("snapshot " + load_path + " is not based on " + base_path);
+		}
+		info << "restore\t" << load_path << " onto " << base_path << " as " << save_path << std::endl;
+	}
+
+private:
+	static std::ifstream open(const std::string& path) {
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		if (!in.is_open()) throw std::runtime_error("cannot load " + path);
+		return in;
+	}
+	static uint32_t tables(std::ifstream& in) {
+		uint32_t size = 0;
+		read(in, size);
+		return size;
+	}
+
+	template<typename type> static void write(std::ostream& out, const type& v) {
+		out.write(reinterpret_cast<const char*>(&v), sizeof(type));
+	}
+	template<typename type> static void read(std::istream& in, type& v) {
+		in.read(reinterpret_cast<char*>(&v), sizeof(type));
+	}
+
+	static void varint(std::string& buf, uint64_t v) {
+		for (; v >= 0x80; v >>= 7) buf.push_back(char(v | 0x80));
+		buf.push_back(char(v));
+	}
+	static uint64_t varint(std::istream& in) {
+		uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			int ch = in.get();
+			if (ch == EOF) break;
+			v |= uint64_t(ch & 0x7f) << shift;
+			if (!(ch & 0x80)) break;
+		}
+		return v;
+	}
+
+	/**
+	 * FNV-1a over the raw words of a table, chained over the tables
+	 */
+	static uint64_t hash(const weight& w, uint64_t h) {
+		if (h == 0) h = 0xcbf29ce484222325ull;
+		for (size_t k = 0; k < w.size(); k++) {
+			uint32_t bits;
+			std::memcpy(&bits, &w[k], sizeof(bits));
+			h = (h ^ bits) * 0x100000001b3ull;
+		}
+		return h;
+	}
+
+private:
+	std::string base_path, load_path, save_path;
+	float step;
+};
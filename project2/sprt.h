@@ -0,0 +1,129 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * sprt.h: Sequential probability ratio test for engine-vs-engine matches
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+/**
+ * generalized SPRT on the game results of engine A against engine B
+ * H0: elo(A) - elo(B) = elo0, H1: elo(A) - elo(B) = elo1
+ *
+ * each result is a score of A, i.e., 1 for a win, 0.5 for a draw, and 0 for a loss
+ * the log-likelihood ratio is the exact ratio of the trinomial likelihoods of the results,
+ *   llr = max log L(p | s1) - max log L(p | s0), where log L(p) = W log pw + D log pd + L log pl
+ * where s0 and s1 are the expected scores of elo0 and elo1, and each maximum is taken over the
+ * probabilities with the expected score, i.e., pw + pd / 2 = s, so the unknown draw rate is fitted
+ * without draws, e.g., in NoGo, it is the exact binomial ratio W log(s1 / s0) + L log((1 - s1) / (1 - s0)),
+ * e.g., w/d/l = 4/0/0 with elo0=0 elo1=200 gives llr = 4 log(0.760 / 0.5) = 1.67, which is still below 2.94
+ *
+ * the arguments are given as "key=value" pairs, e.g., "elo0=0 elo1=10 alpha=0.05 beta=0.05"
+ */
+class sprt {
+public:
+	sprt(const std::string& args = "") : elo0(0), elo1(10), alpha(0.05), beta(0.05), win(0), draw(0), loss(0) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "elo0") elo0 = std::stod(value);
+			else if (key == "elo1") elo1 = std::stod(value);
+			else if (key == "alpha") alpha = std::stod(value);
+			else if (key == "beta") beta = std::stod(value);
+			else throw std::invalid_argument("invalid sprt argument: " + pair);
+		}
+		if (!(elo0 < elo1) || !(alpha > 0 && alpha < 1) || !(beta > 0 && beta < 1))
+			throw std::invalid_argument("invalid sprt bounds: " + args);
+	}
+
+public:
+	/**
+	 * add a result as the score of A
+	 */
+	void update(double score) {
+		if (score > 0.75) win++;
+		else if (score < 0.25) loss++;
+		else draw++;
+	}
+
+	size_t games() const { return win + draw + loss; }
+
+	double llr() const {
+		return likelihood(expected(elo1)) - likelihood(expected(elo0));
+	}
+	double lower() const { return std::log(beta / (1 - alpha)); }
+	double upper() const { return std::log((1 - beta) / alpha); }
+
+	/**
+	 * return 1 if H1 is accepted, -1 if H0 is accepted, or 0 if more games are needed
+	 */
+	int result() const {
+		double v = llr();
+		return v >= upper() ? 1 : v <= lower() ? -1 : 0;
+	}
+	bool is_finished() const { return result() != 0; }
+
+	/**
+	 * estimated elo difference from the average score
+	 */
+	double elo() const {
+		double n = games(), mean = n ? (win + 0.5 * draw) / n : 0.5;
+		mean = std::min(std::max(mean, 1e-3), 1 - 1e-3);
+		return -400 * std::log10(1 / mean - 1);
+	}
+
+	/**
+	 * show the progress of the test
+	 *
+	 * the format is
+	 * sprt    llr = 1.52 (-2.94, 2.94), elo = 12.3 [0, 10], w/d/l = 120/0/100, continue
+	 */
+	void show(std::ostream& out = std::cout) const {
+		std::ios ff(nullptr);
+		ff.copyfmt(out);
+		out << std::fixed << std::setprecision(2);
+		out << "sprt\t" "llr = " << llr() << " (" << lower() << ", " << upper() << "), ";
+		out << std::setprecision(1) << "elo = " << elo() << " [" << elo0 << ", " << elo1 << "], ";
+		out << "w/d/l = " << win << "/" << draw << "/" << loss << ", ";
+		out << (result() > 0 ? "H1 accepted" : result() < 0 ? "H0 accepted" : "continue") << std::endl;
+		out.copyfmt(ff);
+	}
+
+private:
+	static double expected(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+
+	/**
+	 * the maximum log-likelihood of the results over the trinomials of expected score s
+	 *
+	 * the trinomials are (s - pd / 2, pd, 1 - s - pd / 2) for pd in [0, 2 * min(s, 1 - s)],
+	 * where the log-likelihood is concave in pd, so its maximum is found by bisection of the derivative
+	 */
+	double likelihood(double s) const {
+		double lo = 0, hi = 2 * std::min(s, 1 - s);
+		if (draw == 0) hi = 0; // the maximum is at pd = 0, i.e., the binomial
+		for (int i = 0; i < 100 && hi - lo > 1e-12; i++) {
+			double pd = (lo + hi) / 2, pw = s - pd / 2, pl = 1 - s - pd / 2;
+			double slope = draw / pd - win / (2 * pw) - loss / (2 * pl);
+			(slope > 0 ? lo : hi) = pd;
+		}
+		double pd = (lo + hi) / 2, pw = s - pd / 2, pl = 1 - s - pd / 2;
+		return term(win, pw) + term(draw, pd) + term(loss, pl);
+	}
+	static double term(size_t n, double p) { return n ? n * std::log(p) : 0; }
+
+private:
+	double elo0, elo1;
+	double alpha, beta;
+	size_t win, draw, loss;
+};
@@ -12,9 +12,11 @@
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <memory>
 #include "board.h"
 #include "action.h"
 #include "episode.h"
+#include "writer.h"
 
 class statistics {
 public:
@@ -29,6 +31,7 @@ public:
 		: total(total),
 		  block(block ? block : total),
 		  limit(limit ? limit : total),
+		  given(limit != 0),
 		  count(0) {}
 
 public:
@@ -52,12 +55,16 @@ public:
 	 *                                   the average speed of the placer is 955796
 	 * '84.1%': 84.1% of the games reached 24-tiles, i.e., win rate of 24-tile
 	 * '45.3%': 45.3% of the games terminated with 24-tiles as the largest tile
+	 *
+	 * if --alloc is enabled, the heap allocations of the games follow the first line, e.g.,
+	 *         alloc = 152.3/game, 0.4/move, 57.1B/move
 	 */
 	void show(bool tstat = true, size_t blk = 0) const {
 		size_t num = std::min(data.size(), blk ?: block);
 		size_t stat[64] = { 0 };
 		size_t sop = 0, pop = 0, eop = 0;
 		time_t sdu = 0, pdu = 0, edu = 0;
+		allocation::counter alloc = {};
 		board::score sum = 0, max = 0;
 		auto it = data.end();
 		for (size_t i = 0; i < num; i++) {
@@ -71,6 +78,7 @@ public:
 			sdu += ep.time();
 			pdu += ep.time(action::slide::type);
 			edu += ep.time(action::place::type);
+			alloc += ep.allocs();
 		}
 
 		std::ios ff(nullptr);
@@ -83,6 +91,13 @@ public:
 		std::cout <<     " (" << (pop * 1000.0 / pdu);
 		std::cout <<      "|" << (eop * 1000.0 / edu) << ")";
 		std::cout << std::endl;
+		if (allocation::is_enabled()) {
+			std::cout << std::setprecision(1);
+			std::cout << "\t" "alloc = " << (alloc.count * 1.0 / num) << "/game, ";
+			std::cout << (alloc.count * 1.0 / sop) << "/move, ";
+			std::cout << (alloc.bytes * 1.0 / sop) << "B/move";
+			std::cout << std::endl;
+		}
 		std::cout.copyfmt(ff);
 
 		if (!tstat) return;
@@ -113,9 +128,32 @@ public:
 
 	void close_episode(const std::string& flag = "") {
 		data.back().close_episode(flag);
+		record(data.back());
 		if (count % block == 0) show();
 	}
 
+	/**
+	 * append a finished episode, e.g., which is played in parallel outside the statistics
+	 */
+	void push_episode(episode&& game) {
+		if (count++ >= limit) data.pop_front();
+		data.push_back(std::move(game));
+		record(data.back());
+		if (count % block == 0) show();
+	}
+
+	/**
+	 * stream the kept and the coming finished episodes to a writer, e.g., of --save,
+	 * after which only the last block of episodes, or the given limit, is kept in memory for the statistics
+	 * the kept episodes of a resumed training are not streamed again, since they are already in the file
+	 */
+	void stream(std::shared_ptr<record_writer> out, bool resumed = false) {
+		writer = out;
+		if (!resumed) for (const episode& rec : data) record(rec);
+		if (!given) limit = block;
+		while (data.size() > limit) data.pop_front();
+	}
+
 	episode& at(size_t i) {
 		return data.at(i);
 	}
@@ -129,6 +167,21 @@ public:
 		return count;
 	}
 
+	/**
+	 * save and restore the episode counter and the kept records, e.g., for resuming a training
+	 */
+	void save_state(std::ostream& out) const {
+		out << count << std::endl << *this << std::endl;
+	}
+	void load_state(std::istream& in) {
+		size_t n = 0;
+		in >> n;
+		in.ignore(1);
+		data.clear();
+		in >> *this;
+		count = n;
+	}
+
 	friend std::ostream& operator <<(std::ostream& out, const statistics& stat) {
 		for (const episode& rec : stat.data) out << rec << std::endl;
 		return out;
@@ -143,10 +196,20 @@ public:
 		return in;
 	}
 
+private:
+	void record(const episode& rec) {
+		if (!writer) return;
+		std::stringstream ss;
+		ss << rec;
+		writer->push(ss.str());
+	}
+
 private:
 	size_t total;
 	size_t block;
 	size_t limit;
+	bool given; // whether the limit is given, which is kept when streaming
 	size_t count;
 	std::deque<episode> data;
+	std::shared_ptr<record_writer> writer;
 };
@@ -0,0 +1,112 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * sweep.h: Parallel hyperparameter sweep of tuple network training
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "driver.h"
+#include "thread_pool.h"
+
+/**
+ * train several tuple_player configurations side by side in one process, and report their learning curves
+ *
+ * the configurations play the same number of games, where the i-th game of every configuration is
+ * played against a placer seeded with i, so that the curves are compared under the same environment
+ * each block of games of a configuration is a task on the global thread pool, and all configurations
+ * finish a block before the next one starts, so that the curves are reported as they go
+ *
+ * the arguments are given as "key=value" pairs, e.g., "games=100000 block=1000"
+ *  'games': the number of games of each configuration (default 100000)
+ *  'block': the number of games of each point of the curves (default 1000)
+ */
+class sweep {
+public:
+	sweep(const std::vector<std::string>& configs, const std::string& args = "", const std::string& place_args = "")
+		: configs(configs), place_args(place_args), games(100000), block(1000) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "games") games = std::stoul(value);
+			else if (key == "block") block = std::stoul(value);
+			else throw std::invalid_argument("invalid sweep argument: " + pair);
+		}
+		if (configs.empty()) throw std::invalid_argument("sweep needs at least 1 configuration");
+		block = std::max<size_t>(std::min(block, games), 1);
+	}
+
+public:
+	/**
+	 * play a single game with the player against a placer seeded with 'seed', return the score
+	 */
+	board::score play(tuple_player& slide, size_t seed) const {
+		random_placer place(place_args + " seed=" + std::to_string(seed));
+		episode game;
+		game_driver<tuple_player, random_placer>(slide, place).run(game);
+		return game.score();
+	}
+
+	/**
+	 * train all configurations and print the curves
+	 *
+	 * the format is the average score of each block, followed by the final ranking, e.g.,
+	 * games   a0025   a0050   a0100
+	 * 1000    1523.2  1602.8  1544.0
+	 * 2000    2841.5  2790.1  2563.9
+	 */
+	void run(std::ostream& out = std::cout) {
+		std::vector<std::unique_ptr<tuple_player>> players;
+		for (size_t c = 0; c < configs.size(); c++)
+			players.emplace_back(new tuple_player("name=config" + std::to_string(c) + " " + configs[c]));
+
+		std::ios ff(nullptr);
+		ff.copyfmt(out);
+		out << std::fixed << std::setprecision(1);
+		out << "games";
+		for (auto& p : players) out << "\t" << p->name();
+		out << std::endl;
+
+		std::vector<double> average(players.size(), 0);
+		for (size_t base = 0; base < games; base += block) {
+			size_t num = std::min(block, games - base);
+			thread_pool::global().parallel_for(0, players.size(), [&](size_t c) {
+				double sum = 0;
+				for (size_t i = base; i < base + num; i++) sum += play(*players[c], i);
+				average[c] = sum / num;
+			});
+			out << (base + num);
+			for (double avg : average) out << "\t" << avg;
+			out << std::endl;
+		}
+
+		std::vector<size_t> order(players.size());
+		for (size_t c = 0; c < order.size(); c++) order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return average[x] > average[y]; });
+		out << std::endl << "rank\t" "name\t" "avg\t" "config" << std::endl;
+		for (size_t r = 0; r < order.size(); r++)
+			out << (r + 1) << "\t" << players[order[r]]->name() << "\t" << average[order[r]] << "\t" << configs[order[r]] << std::endl;
+		out.copyfmt(ff);
+	}
+
+private:
+	std::vector<std::string> configs;
+	std::string place_args;
+	size_t games;
+	size_t block;
+};
@@ -11,11 +11,30 @@
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
+#include "driver.h"
 #include "statistics.h"
+#include "sprt.h"
+#include "thread_pool.h"
+#include "compact.h"
+#include "layout.h"
+#include "snapshot.h"
+#include "sweep.h"
+#include "variant.h"
+#include "profiler.h"
+#include "alloc.h"
+#include "writer.h"
+
+static volatile std::sig_atomic_t interrupted = 0;
 
 int main(int argc, const char* argv[]) {
 	std::cout << "Threes! Demo: ";
@@ -25,6 +44,19 @@ int main(int argc, const char* argv[]) {
 	size_t total = 1000, block = 0, limit = 0;
 	std::string slide_args, place_args;
 	std::string load_path, save_path;
+	std::string versus_args, sprt_args;
+	std::string compact_args, convert_args;
+	std::string snapshot_args, restore_args;
+	std::string sweep_args;
+	std::string variant_args;
+	std::string profile_args;
+	std::string alloc_args;
+	bool alloc = false;
+	std::string resume_path;
+	size_t checkpoint = 0;
+	std::vector<std::string> configs;
+	size_t threads = 1, sync = 0;
+	bool pin = false;
 	for (int i = 1; i < argc; i++) {
 		std::string arg = argv[i];
 		auto match_arg = [&](std::string flag) -> bool {
@@ -49,8 +81,72 @@ int main(int argc, const char* argv[]) {
 			load_path = next_opt();
 		} else if (match_arg("save")) {
 			save_path = next_opt();
+		} else if (match_arg("versus")) {
+			versus_args = next_opt();
+		} else if (match_arg("sprt")) {
+			sprt_args = next_opt();
+		} else if (match_arg("compact")) {
+			compact_args = next_opt();
+		} else if (match_arg("convert")) {
+			convert_args = next_opt();
+		} else if (match_arg("snapshot")) {
+			snapshot_args = next_opt();
+		} else if (match_arg("restore")) {
+			restore_args = next_opt();
+		} else if (match_arg("sweep")) {
+			sweep_args = next_opt();
+		} else if (match_arg("variant")) {
+			variant_args = next_opt();
+		} else if (match_arg("config")) {
+			configs.push_back(next_opt());
+		} else if (match_arg("resume")) {
+			resume_path = next_opt();
+		} else if (match_arg("checkpoint")) {
+			checkpoint = std::stoull(next_opt());
+		} else if (match_arg("profile")) {
+			profile_args = next_opt();
+		} else if (match_arg("alloc")) { // --alloc, or --alloc="sample=1000 top=10"
+			if (arg.find('=') != std::string::npos) alloc_args = next_opt();
+			alloc = true;
+		} else if (match_arg("threads")) {
+			threads = std::stoull(next_opt());
+		} else if (match_arg("sync")) {
+			sync = std::stoull(next_opt());
+		} else if (match_arg("pin")) {
+			pin = true;
 		}
 	}
+	thread_pool::configure(threads, pin);
+	std::unique_ptr<profiler> prof(profile_args.size() ? new profiler(profile_args) : nullptr);
+	if (alloc) {
+		allocation::start(alloc_args);
+		std::atexit([]() { allocation::report(); });
+	}
+
+	if (compact_args.size()) {
+		compactor(compact_args).run();
+		return 0;
+	}
+	if (convert_args.size()) {
+		layout_converter(convert_args).run();
+		return 0;
+	}
+	if (sweep_args.size() || configs.size()) {
+		sweep(configs, sweep_args, place_args).run();
+		return 0;
+	}
+	if (variant_args.size()) {
+		variant(variant_args).run(slide_args, place_args);
+		return 0;
+	}
+	if (snapshot_args.size()) {
+		snapshot(snapshot_args).create();
+		return 0;
+	}
+	if (restore_args.size()) {
+		snapshot(restore_args).restore();
+		return 0;
+	}
 
 	statistics stats(total, block, limit);
 
@@ -64,32 +160,132 @@ int main(int argc, const char* argv[]) {
 	tuple_player slide(slide_args);
 	random_placer place(place_args);
 
-	while (!stats.is_finished()) {
-//		std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
+	// the training state of --resume is the statistics, the weights, and the random engine of the placer,
+	// it is restored if the file exists, and saved at exit, every --checkpoint games, and on SIGINT or SIGTERM,
+	// so that a resumed training is the same as an uninterrupted one
+	bool resumed = false;
+	if (resume_path.size()) {
+		std::ifstream in(resume_path, std::ios::in | std::ios::binary);
+		char magic[4] = {};
+		if (in.read(magic, 4) && std::string(magic, 4) == "TPRS") {
+			std::string engine;
+			stats.load_state(in);
+			std::getline(in, engine);
+			place.state(engine);
+			slide.load_state(in);
+			resumed = true;
+			std::cout << "resume	" << stats.step() << " games from " << resume_path << std::endl << std::endl;
+		}
+		std::signal(SIGINT, [](int) { interrupted = 1; });
+		std::signal(SIGTERM, [](int) { interrupted = 1; });
+	}
+	auto save_state = [&]() {
+		if (resume_path.empty()) return;
+		std::ofstream out(resume_path + ".tmp", std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write("TPRS", 4);
+		stats.save_state(out);
+		out << place.state() << std::endl;
+		slide.save_state(out);
+		out.close();
+		std::rename((resume_path + ".tmp").c_str(), resume_path.c_str()); // never leave a partial state
+	};
+	auto is_finished = [&]() { return stats.is_finished() || interrupted; };
+	auto is_checkpoint = [&](size_t last) { return checkpoint && stats.step() / checkpoint != last / checkpoint; };
+
+	// the episodes of --save are appended to the file by a background writer as soon as they finish,
+	// starting with the loaded ones, so that the statistics keep only the last block (or --limit) in memory
+	// a resumed training appends to the file, which already has the episodes before the resumed state
+	std::shared_ptr<record_writer> writer;
+	if (save_path.size()) {
+		writer = std::make_shared<record_writer>(save_path, resumed);
+		stats.stream(writer, resumed);
+	}
+
+	auto run = [](episode& game, agent& slide, agent& place) {
 		slide.open_episode("~:" + place.name());
 		place.open_episode(slide.name() + ":~");
 
-		stats.open_episode(slide.name() + ":" + place.name());
-		episode& game = stats.back();
+		game.open_episode(slide.name() + ":" + place.name());
 		while (true) {
 			agent& who = game.take_turns(slide, place);
+			allocation::scope phase(&who == &slide ? allocation::slide : allocation::place);
 			action move = who.take_action(game.state());
 //			std::cerr << game.state() << "#" << game.step() << " " << who.name() << ": " << move << std::endl;
 			if (game.apply_action(move) != true) break;
 			if (who.check_for_win(game.state())) break;
 		}
 		agent& win = game.last_turns(slide, place);
-		stats.close_episode(win.name());
+		game.close_episode(win.name());
 
+		allocation::scope phase(allocation::train);
 		slide.close_episode(win.name());
 		place.close_episode(win.name());
-	}
+	};
 
-	if (save_path.size()) {
-		std::ofstream out(save_path, std::ios::out | std::ios::trunc);
-		out << stats;
-		out.close();
+	auto play = [&](statistics& stats, agent& slide, agent& place) -> board::score {
+//		std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
+		episode game;
+		run(game, slide, place);
+		board::score score = game.score();
+		stats.push_episode(std::move(game));
+		return score;
+	};
+
+	if (sprt_args.empty() && thread_pool::global().size() == 0 && sync == 0) {
+		while (!is_finished()) {
+			play(stats, slide, place);
+			if (is_checkpoint(stats.step() - 1)) save_state();
+		}
+
+	} else if (sprt_args.empty()) { // play games in parallel with forks of the player sharing the weights
+		// the games are played in batches, and the i-th game is played against a placer seeded with i,
+		// the episodes are then appended in order so that the statistics are shown as usual
+		// with --sync=N, the batches are of N games played on fixed weights, whose updates are merged in
+		// the order of games after each batch, so the training is reproducible for any number of threads
+		thread_pool& pool = thread_pool::global();
+		std::vector<std::unique_ptr<tuple_player>> forks;
+		for (size_t k = 0; k <= pool.size(); k++) forks.push_back(slide.fork());
+		for (auto& fork : forks) fork->defer_updates(sync != 0);
+		size_t batch = sync ? sync : (pool.size() + 1) * 8;
+		while (!is_finished()) {
+			size_t base = stats.step(), num = std::min(batch, total - base);
+			std::vector<episode> games(num);
+			std::vector<tuple_player::update_buffer> updates(sync ? num : 0);
+			pool.parallel_for(0, num, [&](size_t i) {
+				tuple_player& fork = *forks[pool.slot()];
+				random_placer place(place_args + " seed=" + std::to_string(base + i));
+				game_driver<tuple_player, random_placer>(fork, place).run(games[i]);
+				if (sync) updates[i] = fork.take_updates();
+			});
+			for (auto& buf : updates) slide.apply_updates(buf);
+			for (episode& game : games) stats.push_episode(std::move(game));
+			if (is_checkpoint(base)) {
+				for (auto& fork : forks) fork->flush_updates();
+				save_state();
+			}
+		}
+
+	} else { // compare --slide (A) with --versus (B) by SPRT, stop early once the test is decided
+		// the i-th games of A and B are played against placers seeded with i, and
+		// A wins the pair if it scores higher, so that the variance of the environment is reduced
+		sprt test(sprt_args);
+		tuple_player versus("name=versus " + versus_args);
+		statistics versus_stats(total, block, limit);
+		for (size_t i = 0; !is_finished() && !test.is_finished(); i++) {
+			random_placer place_a(place_args + " seed=" + std::to_string(i));
+			random_placer place_b(place_args + " seed=" + std::to_string(i));
+			board::score a = play(stats, slide, place_a);
+			board::score b = play(versus_stats, versus, place_b);
+			test.update(a > b ? 1 : a < b ? 0 : 0.5);
+			if (stats.step() % (block ? block : total) == 0 || test.is_finished()) test.show();
+		}
+		if (!stats.is_finished()) { // show the last incomplete block of both
+			stats.summary();
+			versus_stats.summary();
+		}
 	}
 
+	save_state();
+
 	return 0;
 }
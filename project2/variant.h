@@ -0,0 +1,150 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * variant.h: Play and training on the boards of other sizes
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+
+/**
+ * play games on a board of another size, e.g., 3x3 or 5x5, to study how the size changes the game,
+ * or to train a tuple network of that size, which is much faster than the standard 4x4 game
+ * the slider is a random slider or a tuple player, and the placer is a random placer, all of the size,
+ * whose arguments are given by --slide and --place, e.g., the sizes of the tables by init=,
+ * where the tuple patterns of the size are generated from its geometry, see pattern.h
+ * the game starts with 9/16 of the cells filled, i.e., 9 tiles on 4x4 as the standard game
+ *
+ * the sizes are instantiated at compile time, so every variant runs the unrolled slides of its own geometry
+ *
+ * the arguments are given as "key=value" pairs, e.g., "size=3x3 games=10000 seed=0"
+ *  'size': the size of the board, 3x3, 4x4, or 5x5 (default 4x4)
+ *  'games': the number of games (default 10000)
+ *  'block': the number of games of each summary (default games)
+ *  'slider': the slider, random or tuple (default random)
+ *  'seed': the seed of the random agents, unless given by --slide or --place (default 0)
+ */
+class variant {
+public:
+	variant(const std::string& args = "") : size("4x4"), games(10000), block(0), slider("random"), seed(0) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "size") size = value;
+			else if (key == "games") games = std::stoul(value);
+			else if (key == "block") block = std::stoul(value);
+			else if (key == "slider") slider = value;
+			else if (key == "seed") seed = std::stoul(value);
+			else throw std::invalid_argument("invalid variant argument: " + pair);
+		}
+		if (size != "3x3" && size != "4x4" && size != "5x5") throw std::invalid_argument("invalid variant size: " + size);
+		if (slider != "random" && slider != "tuple") throw std::invalid_argument("invalid variant slider: " + slider);
+		if (block == 0) block = games;
+	}
+
+public:
+	/**
+	 * play the games and print the summary of every block
+	 *
+	 * the format is
+	 * variant 3x3     10000 games, avg = 42.1, max = 243, 28.3 moves/game, 5123456 moves/s
+	 * where the games is the number of games so far, and the others are of the last block
+	 */
+	void run(const std::string& slide_args = "", const std::string& place_args = "", std::ostream& out = std::cout) const {
+		if (size == "3x3") run<3, 3>(slide_args, place_args, out);
+		if (size == "4x4") run<4, 4>(slide_args, place_args, out);
+		if (size == "5x5") run<5, 5>(slide_args, place_args, out);
+	}
+
+private:
+	template<unsigned W, unsigned H>
+	void run(const std::string& slide_args, const std::string& place_args, std::ostream& out) const {
+		typedef basic_board<W, H> board_t;
+		std::unique_ptr<basic_agent<board_t>> slide;
+		if (slider == "tuple") slide.reset(new basic_tuple_player<board_t>("name=slide role=slider " + slide_args));
+		else slide.reset(new basic_random_slider<board_t>("seed=" + std::to_string(seed + 1) + " " + slide_args));
+		basic_random_placer<board_t> place("seed=" + std::to_string(seed) + " " + place_args);
+
+		for (size_t i = 0; i < games; ) {
+			uint64_t sum = 0, max = 0, moves = 0;
+			size_t num = std::min(block, games - i);
+			auto start = std::chrono::steady_clock::now();
+			for (size_t n = 0; n < num; n++) {
+				uint64_t score = 0;
+				moves += play<board_t>(*slide, place, score);
+				sum += score;
+				max = std::max(max, score);
+			}
+			double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			i += num;
+
+			std::ios ff(nullptr);
+			ff.copyfmt(out);
+			out << std::fixed << std::setprecision(1);
+			out << "variant\t" << W << "x" << H << "\t" << i << " games, ";
+			out << "avg = " << (num ? double(sum) / num : 0) << ", max = " << max << ", ";
+			out << (num ? double(moves) / num : 0) << " moves/game, ";
+			out << std::setprecision(0) << (sec > 0 ? moves / sec : 0) << " moves/s" << std::endl;
+			out.copyfmt(ff);
+		}
+	}
+
+	/**
+	 * play a single game, store the value of the final board in 'score' and return the number of slides
+	 */
+	template<typename board_t>
+	static size_t play(basic_agent<board_t>& slide, basic_agent<board_t>& place, uint64_t& score) {
+		board_t b;
+		size_t moves = 0;
+		bool slid = false; // whether the slider made the last move, i.e., wins
+		slide.open_episode("~:" + place.name());
+		place.open_episode(slide.name() + ":~");
+		for (unsigned n = 0; n < board_t::cells * 9 / 16 && apply(b, place.take_action(b)) != -1; n++); // the initial tiles
+		while (true) {
+			if (apply(b, slide.take_action(b)) == -1) break;
+			slid = true;
+			moves++;
+			if (apply(b, place.take_action(b)) == -1) break;
+			slid = false;
+		}
+		const std::string& win = slid ? slide.name() : place.name();
+		slide.close_episode(win);
+		place.close_episode(win);
+		score = b.value();
+		return moves;
+	}
+
+	/**
+	 * apply an action to a board of any size, as action::apply does to the standard board
+	 */
+	template<typename board_t>
+	static typename board_t::reward apply(board_t& b, const action& a) {
+		if (a.type() == action::slide::type) return b.slide(action::slide(a).event());
+		if (a.type() == action::place::type) {
+			action::place p(a);
+			return b.place(p.position(), p.tile(), p.hint());
+		}
+		return -1;
+	}
+
+private:
+	std::string size;
+	size_t games;
+	size_t block;
+	std::string slider;
+	size_t seed;
+};
@@ -0,0 +1,134 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * weight.h: Lookup table template for n-tuple network
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <new>
+#include <sys/mman.h>
+
+/**
+ * lookup table of floats allocated from anonymous zero pages, so that a page is backed by memory
+ * only after its first write, and creating a huge table costs nothing until it is trained
+ *
+ * a table is saved as uint64 size followed by the raw floats, or, if the table has all-zero blocks,
+ * as uint64 (size | 2^63), a bitmap of the blocks of 'block_size' floats that are nonzero, and the raw
+ * floats of the nonzero blocks only; both forms are understood by the loader
+ */
+class weight {
+public:
+	typedef float type;
+	static const size_t block_size = 1024; // 4KB, i.e., a page of floats
+	static const uint64_t sparse = uint64_t(1) << 63;
+
+public:
+	weight() : value(nullptr), length(0) {}
+	weight(size_t len) : weight() { allocate(len); }
+	weight(weight&& f) noexcept : value(f.value), length(f.length) { f.value = nullptr; f.length = 0; }
+	weight(const weight& f) : weight(f.length) { copy(f); }
+	~weight() { release(); }
+
+	weight& operator =(const weight& f) {
+		if (this != &f) {
+			allocate(f.length);
+			copy(f);
+		}
+		return *this;
+	}
+	weight& operator =(weight&& f) noexcept {
+		std::swap(value, f.value);
+		std::swap(length, f.length);
+		return *this;
+	}
+	type& operator[] (size_t i) { return value[i]; }
+	const type& operator[] (size_t i) const { return value[i]; }
+	size_t size() const { return length; }
+
+public:
+	friend std::ostream& operator <<(std::ostream& out, const weight& w) {
+		size_t blocks = (w.length + block_size - 1) / block_size;
+		std::vector<uint8_t> bitmap((blocks + 7) / 8, 0);
+		size_t nonzero = 0;
+		for (size_t b = 0; b < blocks; b++) {
+			const type* begin = w.value + b * block_size, * end = w.value + std::min(w.length, (b + 1) * block_size);
+			if (std::any_of(begin, end, [](type v) { return v != 0; })) {
+				bitmap[b / 8] |= 1 << (b % 8);
+				nonzero++;
+			}
+		}
+		uint64_t size = w.length;
+		if (nonzero == blocks) {
+			out.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+			out.write(reinterpret_cast<const char*>(w.value), sizeof(type) * size);
+			return out;
+		}
+		size |= sparse;
+		out.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+		out.write(reinterpret_cast<const char*>(bitmap.data()), bitmap.size());
+		for (size_t b = 0; b < blocks; b++) {
+			if (!(bitmap[b / 8] & (1 << (b % 8)))) continue;
+			size_t len = std::min(size_t(block_size), w.length - b * block_size);
+			out.write(reinterpret_cast<const char*>(w.value + b * block_size), sizeof(type) * len);
+		}
+		return out;
+	}
+	friend std::istream& operator >>(std::istream& in, weight& w) {
+		uint64_t size = 0;
+		in.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
+		w.allocate(size & ~sparse);
+		if (!(size & sparse)) {
+			in.read(reinterpret_cast<char*>(w.value), sizeof(type) * w.length);
+			return in;
+		}
+		size_t blocks = (w.length + block_size - 1) / block_size;
+		std::vector<uint8_t> bitmap((blocks + 7) / 8, 0);
+		in.read(reinterpret_cast<char*>(bitmap.data()), bitmap.size());
+		for (size_t b = 0; b < blocks; b++) {
+			if (!(bitmap[b / 8] & (1 << (b % 8)))) continue;
+			size_t len = std::min(size_t(block_size), w.length - b * block_size);
+			in.read(reinterpret_cast<char*>(w.value + b * block_size), sizeof(type) * len);
+		}
+		return in;
+	}
+
+protected:
+	/**
+	 * copy the nonzero blocks of a table of the same size into this one of zeros,
+	 * so that a copy of a sparse table stays sparse
+	 */
+	void copy(const weight& f) {
+		for (size_t i = 0; i < length; i += block_size) {
+			const type* begin = f.value + i, * end = f.value + std::min(length, i + block_size);
+			if (std::any_of(begin, end, [](type v) { return v != 0; })) std::copy(begin, end, value + i);
+		}
+	}
+
+	/**
+	 * replace the table with a new one of zeros
+	 */
+	void allocate(size_t len) {
+		release();
+		if (len == 0) return;
+		void* p = mmap(nullptr, sizeof(type) * len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) throw std::bad_alloc();
+		value = static_cast<type*>(p);
+		length = len;
+	}
+	void release() {
+		if (value) munmap(value, sizeof(type) * length);
+		value = nullptr;
+		length = 0;
+	}
+
+protected:
+	type* value;
+	size_t length;
+};
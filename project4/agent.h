@@ -16,8 +16,13 @@
 #include <algorithm>
 #include <fstream>
 #include <ctime> 
+#include <chrono>
+#include <memory>
 #include "board.h"
 #include "action.h"
+#include "trace.h"
+#include "dataset.h"
+#include "thread_pool.h"
 
 class agent {
 public:
@@ -124,6 +129,37 @@ public:
 		for(size_t i =0;i<myop_space.size();i++){
 			myop_space[i] = action::place(i,opponent);
 		}
+		if (meta.find("exploration") != meta.end())
+			exploration_c=float(meta["exploration"]);
+		if (meta.find("rave_b") != meta.end())
+			rave_b=double(meta["rave_b"]);
+		if (meta.find("timeout") != meta.end())
+			timeout=duration();
+		if (meta.find("simulation") != meta.end())
+			simulation_limit=simulation_step();
+		if (meta.find("lgrf") != meta.end())
+			lgrf=int(meta["lgrf"]);
+		clear_replies();
+		if (meta.find("truncate") != meta.end())
+			truncate=int(meta["truncate"]);
+		if (meta.find("truncate_scale") != meta.end())
+			truncate_scale=double(meta["truncate_scale"]);
+		if (meta.find("dataset") != meta.end())
+			dataset=dataset_writer::open(meta["dataset"]);
+		if (meta.find("trace") != meta.end())
+			trace.reset(new tracer(meta.find("trace_size") != meta.end() ? size_t(meta["trace_size"]) : 1 << 18));
+		if (meta.find("threads") != meta.end() && int(meta["threads"]) > 1) {
+			std::string args;
+			for (auto& kv : meta) {
+				if (kv.first == "threads" || kv.first == "seed" || kv.first == "trace" || kv.first == "dataset") continue;
+				args += kv.first + "=" + kv.second.value + " ";
+			}
+			int seed = meta.find("seed") != meta.end() ? int(meta["seed"]) : 0;
+			for (int k = 1; k < int(meta["threads"]); k++) {
+				helpers.emplace_back(new mcts_player(args + "seed=" + std::to_string(seed + k * 7919)));
+				helpers.back()->trace = trace;
+			}
+		}
 	}
 	/*
 	virtual action take_random_action(const board& state) {
@@ -149,9 +185,9 @@ public:
 	struct node{	
 			node *parent=nullptr;
 			std::vector<node*> childrens;
-			int wi=0;
+			double wi=0;
 			int si=0;
-			int wi_rave=0;
+			double wi_rave=0;
 			int si_rave=0;
 			bool isleaf=true;
 			board state;
@@ -187,7 +223,7 @@ public:
 				}
 				*/
 				
-				double b=0.0015;
+				double b=rave_b;
 				double beta=double(child->si_rave)/(double(child->si)+double(child->si_rave)+4*double(child->si*child->si_rave*b));
 				
 				if(who==child->self){
@@ -277,7 +313,7 @@ public:
 				}
 			}
 
-			int rollout(node* current,std::vector<action::place>* my_space, std::vector<action::place>* op_space){
+			double rollout(node* current,std::vector<action::place>* my_space, std::vector<action::place>* op_space){
 				
 				board::piece_type myop=my_opponent(current->self);
 				board::piece_type next;
@@ -289,14 +325,28 @@ public:
 
 				//std::cout<<"simulation..."<<std::endl;
 				board temp=current->state;
+
+				if(lgrf){
+					playout.clear();
+					for(node* n=current;n->parent!=nullptr;n=n->parent){
+						playout.push_back(n->move_placed);
+					}
+					std::reverse(playout.begin(),playout.end());
+				}
 			
-				int score=0;
+				double score=0;
+				int played=0;
 				if(current->is_terminal){
 					score=(who!=myop);
+					if(lgrf) update_replies(score);
 					return score;
 				}
 				
 				while(1){		
+					if(truncate&&played++>=truncate){
+						score=evaluate(temp);
+						break;
+					}
 					int terminate=1;
 					if(myop==who){
 						current_space=my_space;
@@ -306,11 +356,23 @@ public:
 						current_space=op_space;
 						next=who;
 					}
+
+					if(lgrf){
+						action::place reply=last_good_reply(myop);
+						board t=temp;
+						if(reply.position().i!=-1&&reply.apply(t)==board::legal){
+							temp=t;
+							playout.push_back(reply);
+							myop=next;
+							continue;
+						}
+					}
 					
 					for (const action::place& move : *(current_space)) {
 						board t=temp;
 						if (move.apply(t) == board::legal){
-							move.apply(temp);
+							temp=t;
+							if(lgrf) playout.push_back(move);
 							terminate = 0;
 							break;
 						}
@@ -327,11 +389,59 @@ public:
 					}
 					myop=next;
 				}
+				if(lgrf) update_replies(score);
 				return score;
 
 			}
 
-			void backpropogation(node *current, int score){
+			/**
+			 * last-good-reply with forgetting, LGRF-2 falling back to LGRF-1
+			 * the reply of the colour to play is looked up by the last two moves of the playout
+			 */
+			action::place last_good_reply(board::piece_type colour) const{
+				const size_t n=playout.size();
+				int last1=n>=1?playout[n-1].position().i:-1;
+				int last2=n>=2?playout[n-2].position().i:-1;
+				int c=colour-1;
+				int reply=-1;
+				if(last2!=-1&&last1!=-1) reply=reply2[c][last2*cells+last1];
+				if(reply==-1&&last1!=-1) reply=reply1[c][last1];
+				return reply!=-1?action::place(reply,colour):action::place();
+			}
+
+			/**
+			 * store the replies of the winner of the playout, and forget the replies of the loser
+			 */
+			void update_replies(double score){
+				board::piece_type winner=score>0.5?who:opponent;
+				for(size_t i=1;i<playout.size();i++){
+					board::piece_type colour=playout[i].color();
+					int c=colour-1;
+					int move=playout[i].position().i;
+					int last1=playout[i-1].position().i;
+					int last2=i>=2?playout[i-2].position().i:-1;
+					if(colour==winner){
+						reply1[c][last1]=move;
+						if(last2!=-1) reply2[c][last2*cells+last1]=move;
+					}
+					else{
+						if(reply1[c][last1]==move) reply1[c][last1]=-1;
+						if(last2!=-1&&reply2[c][last2*cells+last1]==move) reply2[c][last2*cells+last1]=-1;
+					}
+				}
+			}
+
+			/**
+			 * fast static evaluation of a truncated playout, i.e., the probability that who wins
+			 * the side with more legal moves left is more likely to make the last move
+			 */
+			double evaluate(const board& state) const{
+				std::array<int, 3> legal=state.count_legal();
+				int mobility=legal[who]-legal[opponent];
+				return 1.0/(1.0+std::exp(-mobility/truncate_scale));
+			}
+
+			void backpropogation(node *current, double score){
 				
 				std::vector<action::place> moves;
 				bool exist=false;
@@ -370,6 +480,32 @@ public:
 				//std::cout<<"backpropogate"<<std::endl;
 			}
 
+	void clear_replies(){
+		for(int c=0;c<2;c++){
+			std::fill(reply1[c].begin(),reply1[c].end(),-1);
+			std::fill(reply2[c].begin(),reply2[c].end(),-1);
+		}
+	}
+
+	virtual void open_episode(const std::string& flag = "") {
+		steps=0;
+		clear_replies();
+		samples.clear();
+		for(auto& helper:helpers) helper->open_episode(flag);
+	}
+
+	/**
+	 * label the positions of this episode by the final result, and send them to the dataset
+	 */
+	virtual void close_episode(const std::string& flag = "") {
+		if(!dataset||samples.empty()) return;
+		for(sample& s:samples){
+			s.result=(flag==name());
+		}
+		dataset->push(std::move(samples));
+		samples.clear();
+	}
+
 	void deletenode(node * current){
 		for(int i=0;i<current->childrens.size();i++){
 			deletenode(current->childrens[i]);
@@ -381,59 +517,134 @@ public:
 	virtual action take_action(const board& state) {
 		action::place best_move=action();
 		int simulation_count=0;
-		int time_duration=0;
-				
+
+		steps++;
+		if(trace) trace->clear();
+		uint64_t traced=trace?trace->now():0;
+		double budget=time_budget();
+		// all trees stop at the same deadline, so that a move takes the budget even if the helpers
+		// have to wait for free workers of the pool
+		auto deadline=std::chrono::steady_clock::now()+std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(budget));
+
+		// root parallelization, each helper searches its own tree on the global thread pool,
+		// and the root statistics of all trees are summed up
+		std::vector<double> visits(space.size(),-1);
+		double wins=0, total=0;
+		if(helpers.empty()){
+			simulation_count=search(state,budget>0,deadline,visits,wins,total);
+		}
+		else{
+			std::vector<std::vector<double>> helper_visits(helpers.size(),std::vector<double>(space.size(),-1));
+			std::vector<double> helper_wins(helpers.size(),0), helper_total(helpers.size(),0);
+			std::vector<int> helper_count(helpers.size(),0);
+			thread_pool::task_group group;
+			for(size_t k=0;k<helpers.size();k++){
+				group.run([&,k](){
+					helper_count[k]=helpers[k]->search(state,budget>0,deadline,helper_visits[k],helper_wins[k],helper_total[k]);
+				});
+			}
+			simulation_count=search(state,budget>0,deadline,visits,wins,total);
+			group.wait();
+			for(size_t k=0;k<helpers.size();k++){
+				for(size_t i=0;i<visits.size();i++){
+					if(helper_visits[k][i]>=0) visits[i]=std::max(visits[i],0.0)+helper_visits[k][i];
+				}
+				wins+=helper_wins[k];
+				total+=helper_total[k];
+				simulation_count+=helper_count[k];
+			}
+		}
+
+		//std::cout<<"choose moves"<<std::endl;
+		double bestcount=-1;
+		for(size_t i=0;i<visits.size();i++){
+			if(visits[i]>bestcount){
+				bestcount=visits[i];
+				best_move=action::place(i,who);
+			}
+		}
+
+		// a position without legal move, where the player resigns, is no policy target
+		if(dataset&&total>0&&bestcount>0){
+			for(double& v:visits) v=std::max(v,0.0);
+			samples.emplace_back(state,who,float(wins/total),visits);
+		}
+
+		if(trace){
+			trace->record("take_action",traced,trace->now());
+			dump_trace(simulation_count);
+		}
+		return best_move;
+	}
+
+	/**
+	 * run the simulations of a move on a new tree, and add the visit count of each root child
+	 * to visits (indexed by position, which stays -1 for illegal moves), and the wins and visits
+	 * of the root to wins and total, until simulation= is reached or, if timed, the deadline is passed
+	 * return the number of simulations, which is 0 if the search starts after the deadline
+	 */
+	int search(const board& state, bool timed, std::chrono::steady_clock::time_point deadline,
+			std::vector<double>& visits, double& wins, double& total){
+		int simulation_count=0;
+		if(timed&&std::chrono::steady_clock::now()>=deadline) return 0;
 		node *root=new node(nullptr,state, opponent);
 
 		std::vector<action::place> my_space=space;
 		std::vector<action::place> opponent_space=myop_space;
-		steps++;
-		start=clock();
 		while(1){
+			tracer::scope simulation(trace.get(),"simulation");
 			simulation_count++;
-			node *best_leaf=selection(root);
-			node *new_leaf=expand(best_leaf);
-			int score=rollout(new_leaf, &my_space, &opponent_space);
-			backpropogation(new_leaf,score);
+			node *best_leaf, *new_leaf;
+			double score;
+			{ tracer::scope phase(trace.get(),"selection"); best_leaf=selection(root); }
+			{ tracer::scope phase(trace.get(),"expansion"); new_leaf=expand(best_leaf); }
+			{ tracer::scope phase(trace.get(),"rollout"); score=rollout(new_leaf, &my_space, &opponent_space); }
+			{ tracer::scope phase(trace.get(),"backpropagation"); backpropogation(new_leaf,score); }
 			
 			//std::cout<<"si: "<<root->childrens[0]->si<<"	";
 			//std::cout<<"si_rave: "<<root->childrens[0]->si_rave<<"	";
 			//std::cout<<"wi: "<<root->childrens[0]->wi<<"	";
 			//std::cout<<"wi_rave: "<<root->childrens[0]->wi_rave<<std::endl;
 			
-			if(simulation_count%100==0){
-				end=clock();
-				if(steps<=4){
-					if(double(end-start)/CLOCKS_PER_SEC>4.0){
-						break;
-					}
-				}
-				else if(steps<=26){
-					if(double(end-start)/CLOCKS_PER_SEC>8.3){
-						break;
-					}
-				}
-				else{
-					if(double(end-start)/CLOCKS_PER_SEC>4.0){
-						break;
-					}
-				}
+			if(simulation_limit&&simulation_count>=simulation_limit){
+				break;
+			}
+			if(timed&&simulation_count%100==0&&std::chrono::steady_clock::now()>deadline){
+				break;
 			}
 
 		}
-		//std::cout<<"choose moves"<<std::endl;
-		int bestcount=-1;
-		
-		for(int i=0;i<root->childrens.size();i++){
-			if(root->childrens[i]->si>bestcount){
-				bestcount=root->childrens[i]->si;
-				best_move=root->childrens[i]->move_placed;
-			}
+
+		for(node* child:root->childrens){
+			visits[child->move_placed.position().i]=child->si;
 		}
-		
-		
-		deletenode(root);
-		return best_move;
+		wins+=root->wi;
+		total+=root->si;
+
+		{ tracer::scope gc(trace.get(),"gc"); deletenode(root); }
+		return simulation_count;
+	}
+
+	/**
+	 * thinking time of this move in seconds, or 0 if the move is only limited by simulation=
+	 * the default schedule spends more time in the middle game
+	 */
+	double time_budget() const{
+		if(timeout>0) return timeout/1000.0;
+		if(simulation_limit>0) return 0;
+		if(steps<=4) return 4.0;
+		if(steps<=26) return 8.3;
+		return 4.0;
+	}
+
+	/**
+	 * dump the trace of the last move to "<trace>.<name>.<step>.json"
+	 */
+	void dump_trace(int simulation_count){
+		std::string path=property("trace")+"."+name()+"."+std::to_string(steps)+".json";
+		trace->dump(path,{{"player",name()},{"step",std::to_string(steps)},
+			{"simulations",std::to_string(simulation_count)},{"events",std::to_string(trace->recorded())}});
 	}
 
 private:
@@ -442,7 +653,21 @@ private:
 	board::piece_type who;
 	board::piece_type opponent;
 	float exploration_c=0.75;
-	clock_t start,end;
+	double rave_b=0.0015;
+	int timeout=0;
+	int simulation_limit=0;
 	int steps=0;
+	std::shared_ptr<tracer> trace;
+	std::vector<std::unique_ptr<mcts_player>> helpers;
+	std::shared_ptr<dataset_writer> dataset;
+	std::vector<sample> samples;
+
+	static constexpr int cells=board::size_x*board::size_y;
+	bool lgrf=false;
+	int truncate=0;
+	double truncate_scale=4.0;
+	std::array<std::array<int16_t,cells>,2> reply1;
+	std::array<std::array<int16_t,cells*cells>,2> reply2;
+	std::vector<action::place> playout;
 };
 
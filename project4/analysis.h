@@ -0,0 +1,186 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * analysis.h: Parallel analysis of saved game records
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include "sgf.h"
+#include "thread_pool.h"
+
+/**
+ * analyze a file of game records, e.g., the file saved by --save
+ * the games are split over the global thread pool, where each chunk of games is parsed
+ * directly from the mapped file
+ *
+ * the arguments are given as "key=value" pairs, e.g., "load=stats.txt"
+ *  'load': the path of the game records
+ */
+class analysis {
+public:
+	analysis(const std::string& args = "") {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "load") path = value;
+			else throw std::invalid_argument("invalid analysis argument: " + pair);
+		}
+	}
+
+	struct player_stat {
+		size_t games = 0, wins = 0;
+		size_t black = 0, black_wins = 0;
+		size_t white = 0, white_wins = 0;
+		std::vector<uint32_t> times; // thinking time of each move in milliseconds
+	};
+
+	struct summary {
+		size_t games = 0;
+		size_t moves = 0;
+		size_t min_length = -1ul, max_length = 0;
+		std::map<std::string, player_stat> players;
+
+		void merge(summary& s) {
+			games += s.games;
+			moves += s.moves;
+			min_length = std::min(min_length, s.min_length);
+			max_length = std::max(max_length, s.max_length);
+			for (auto& it : s.players) {
+				player_stat& p = players[it.first], &q = it.second;
+				p.games += q.games, p.wins += q.wins;
+				p.black += q.black, p.black_wins += q.black_wins;
+				p.white += q.white, p.white_wins += q.white_wins;
+				p.times.insert(p.times.end(), q.times.begin(), q.times.end());
+			}
+		}
+	};
+
+public:
+	/**
+	 * accumulate the statistics of a single game record
+	 */
+	static void accumulate(const sgf_reader::token& game, summary& sum) {
+		sgf_reader::token black, white, result;
+		std::vector<uint32_t> btimes, wtimes;
+		size_t length = 0;
+		char last = 0;
+		sgf_reader::cursor cur(game);
+		for (sgf_reader::property prop; cur.next(prop); ) {
+			if (prop.node == 0) {
+				if (prop.ident == "PB") black = prop.value;
+				else if (prop.ident == "PW") white = prop.value;
+				else if (prop.ident == "RE") result = prop.value;
+			} else if (prop.ident == "B" || prop.ident == "W") {
+				last = prop.ident.data[0];
+				(last == 'B' ? btimes : wtimes).push_back(0); // a move without comment takes 0 ms
+				length++;
+			} else if (prop.ident == "C" && last) {
+				(last == 'B' ? btimes : wtimes).back() = prop.value.number();
+				last = 0;
+			}
+		}
+		bool black_win = result.size && result.data[0] == 'B';
+
+		sum.games++;
+		sum.moves += length;
+		sum.min_length = std::min(sum.min_length, length);
+		sum.max_length = std::max(sum.max_length, length);
+		player_stat& b = sum.players[black.str()];
+		b.games++, b.black++;
+		b.wins += black_win, b.black_wins += black_win;
+		b.times.insert(b.times.end(), btimes.begin(), btimes.end());
+		player_stat& w = sum.players[white.str()];
+		w.games++, w.white++;
+		w.wins += !black_win, w.white_wins += !black_win;
+		w.times.insert(w.times.end(), wtimes.begin(), wtimes.end());
+	}
+
+	/**
+	 * analyze the file and print the report
+	 *
+	 * the format is
+	 * games = 1000, length = 45.3 (30|64), time = 0.012 s
+	 * name    games   win     black   white   moves   avg     p50     p90     p99     max
+	 * black   1000    53.5%   53.5%   -       22651   180.2   171     252     310     402
+	 *
+	 * where
+	 *  'length = 45.3 (30|64)': the average game length is 45.3 moves, the shortest is 30 and the longest is 64
+	 *  'win', 'black', 'white': the win rate in all games, as black, and as white
+	 *  'avg', 'p50', ...: the average and the percentiles of the thinking time of each move in milliseconds
+	 */
+	bool run(std::ostream& out = std::cout) const {
+		auto start = std::chrono::steady_clock::now();
+		sgf_reader file(path);
+		if (!file.is_open()) {
+			std::cerr << "cannot open " << path << std::endl;
+			return false;
+		}
+		std::vector<sgf_reader::token> games = file.games();
+
+		thread_pool& pool = thread_pool::global();
+		std::vector<summary> partial(pool.size() + 1);
+		pool.parallel_for(0, games.size(), [&](size_t i) {
+			accumulate(games[i], partial[pool.slot()]);
+		}, 256);
+
+		summary sum;
+		for (summary& s : partial) sum.merge(s);
+		auto stop = std::chrono::steady_clock::now();
+
+		std::ios ff(nullptr);
+		ff.copyfmt(out);
+		out << std::fixed << std::setprecision(1);
+		out << "games = " << sum.games << ", ";
+		out << "length = " << (sum.games ? sum.moves * 1.0 / sum.games : 0);
+		out << " (" << (sum.games ? sum.min_length : 0) << "|" << sum.max_length << "), ";
+		out << "time = " << std::setprecision(3) << std::chrono::duration<double>(stop - start).count() << " s";
+		out << std::setprecision(1) << std::endl;
+		out << "name\t" "games\t" "win\t" "black\t" "white\t" "moves\t" "avg\t" "p50\t" "p90\t" "p99\t" "max" << std::endl;
+		for (auto& it : sum.players) {
+			const player_stat& p = it.second;
+			auto rate = [](size_t win, size_t num) -> std::string {
+				if (num == 0) return "-";
+				std::stringstream ss;
+				ss << std::fixed << std::setprecision(1) << (win * 100.0 / num) << "%";
+				return ss.str();
+			};
+			std::vector<uint32_t> times = p.times;
+			uint64_t total = 0;
+			for (uint32_t t : times) total += t;
+			out << it.first << "\t" << p.games << "\t";
+			out << rate(p.wins, p.games) << "\t" << rate(p.black_wins, p.black) << "\t" << rate(p.white_wins, p.white) << "\t";
+			out << times.size() << "\t" << (times.size() ? total * 1.0 / times.size() : 0);
+			for (double q : { 0.5, 0.9, 0.99, 1.0 }) out << "\t" << percentile(times, q);
+			out << std::endl;
+		}
+		out.copyfmt(ff);
+		return true;
+	}
+
+	/**
+	 * nearest-rank percentile, note that the order of the values is changed
+	 */
+	static uint32_t percentile(std::vector<uint32_t>& values, double q) {
+		if (values.empty()) return 0;
+		size_t rank = std::min(values.size() - 1, size_t(std::ceil(q * values.size())) - (q > 0));
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+
+private:
+	std::string path;
+};
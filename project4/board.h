@@ -137,6 +137,59 @@ public:
 		return place(p.x, p.y, who);
 	}
 
+	/**
+	 * count the positions where black and white can legally place a stone, no matter whose turn it is,
+	 * indexed by the piece type, e.g., count_legal()[piece_type::black]
+	 *
+	 * the liberties of all blocks are counted by a single pass, so that an empty position is legal for a side
+	 * if the new stone has an empty neighbor or joins a block of another liberty, and no adjacent block of
+	 * the opponent has the position as its only liberty, without placing any stone
+	 */
+	std::array<int, 3> count_legal() const {
+		const int n = size_x * size_y, dx[] = {-1, 1, 0, 0}, dy[] = {0, 0, -1, 1};
+		int block[n], liberty[n], mark[n], stack[n]; // the block of each stone, the liberties of each block
+		std::fill(block, block + n, -1);
+		std::fill(mark, mark + n, -1); // the last block whose liberty is the empty position
+		for (int i = 0; i < n; i++) {
+			point p(i);
+			cell who = stone[p.x][p.y];
+			if ((who != piece_type::black && who != piece_type::white) || block[i] != -1) continue;
+			int top = 0;
+			liberty[i] = 0;
+			block[i] = i;
+			for (stack[top++] = i; top; ) {
+				point q(stack[--top]);
+				for (int d = 0; d < 4; d++) {
+					point r(q.x + dx[d], q.y + dy[d]);
+					if (r.x < 0 || r.x >= size_x || r.y < 0 || r.y >= size_y) continue;
+					cell near = stone[r.x][r.y];
+					if (near == piece_type::empty && mark[r.i] != i) mark[r.i] = i, liberty[i]++;
+					else if (near == who && block[r.i] == -1) block[r.i] = i, stack[top++] = r.i;
+				}
+			}
+		}
+
+		std::array<int, 3> count = {};
+		for (int i = 0; i < n; i++) {
+			point p(i);
+			if (stone[p.x][p.y] != piece_type::empty) continue;
+			bool alive[3] = {}, take[3] = {}; // whether the stone of a side has a liberty, or takes a block
+			for (int d = 0; d < 4; d++) {
+				point r(p.x + dx[d], p.y + dy[d]);
+				if (r.x < 0 || r.x >= size_x || r.y < 0 || r.y >= size_y) continue;
+				cell near = stone[r.x][r.y];
+				if (near == piece_type::empty) alive[piece_type::black] = alive[piece_type::white] = true;
+				else if (near != piece_type::black && near != piece_type::white) continue;
+				else if (liberty[block[r.i]] > 1) alive[near] = true;
+				else take[3u - near] = true;
+			}
+			for (unsigned who : {piece_type::black, piece_type::white})
+				count[who] += alive[who] && !take[who];
+		}
+		return count;
+	}
+	int count_legal(unsigned who) const { return count_legal()[who]; }
+
 	/**
 	 * calculate the liberty of the block of piece at [x][y]
 	 * return >= 0 if [x][y] is placed by who; otherwise return -1
@@ -0,0 +1,137 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * dataset.h: Binary dataset of self-play positions labelled by search statistics
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include "board.h"
+
+/**
+ * a position labelled with the search output, stored as a fixed-size little-endian record
+ *
+ * the file starts with a 12-byte header: "NGDS", uint32 version (1), uint32 record size (192)
+ * followed by records of
+ *  'stones':  2 bits per cell (empty 0, black 1, white 2, hollow 3) in 1-d index order,
+ *             cell i is at bits (2 * i % 8) of byte (i / 4)
+ *  'who':     the side to move, black 1 or white 2
+ *  'result':  1 if the side to move finally won the game, otherwise 0
+ *  'value':   the root value of the search, i.e., the win rate of the side to move
+ *  'policy':  the root visit distribution over cells in 1-d index order, scaled to 0 ~ 65535
+ */
+struct sample {
+	uint8_t stones[21];
+	uint8_t who;
+	uint8_t result;
+	uint8_t reserved;
+	float value;
+	uint16_t policy[board::size_x * board::size_y];
+	uint16_t padding;
+
+	sample() { std::memset(this, 0, sizeof(sample)); }
+	sample(const board& state, board::piece_type who, float value, const std::vector<double>& visits) : sample() {
+		for (int i = 0; i < board::size_x * board::size_y; i++)
+			stones[i / 4] |= (state(i) & 0b11) << (2 * (i % 4));
+		this->who = who;
+		this->value = value;
+		double sum = 0;
+		for (double v : visits) sum += v;
+		for (size_t i = 0; i < visits.size() && sum > 0; i++)
+			policy[i] = uint16_t(visits[i] / sum * 65535 + 0.5);
+	}
+};
+static_assert(sizeof(sample) == 192, "unexpected sample layout");
+
+/**
+ * writer that appends samples to a dataset file from a background thread
+ *
+ * the producer only moves the samples into a bounded queue and never touches the file,
+ * it waits only if the writer falls more than 'capacity' batches behind
+ * writers are shared by path, so the players of a self-play match can write to the same file
+ */
+class dataset_writer {
+public:
+	dataset_writer(const std::string& path, size_t capacity = 256) : capacity(capacity), stop(false) {
+		out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) throw std::runtime_error("cannot open dataset " + path);
+		uint32_t version = 1, size = sizeof(sample);
+		out.write("NGDS", 4);
+		out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+		out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		worker = std::thread(&dataset_writer::loop, this);
+	}
+	~dataset_writer() {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stop = true;
+		}
+		ready.notify_all();
+		worker.join();
+		out.close();
+	}
+	dataset_writer(const dataset_writer&) = delete;
+	dataset_writer& operator =(const dataset_writer&) = delete;
+
+	/**
+	 * queue a batch of samples, e.g., all positions of an episode
+	 */
+	void push(std::vector<sample>&& batch) {
+		std::unique_lock<std::mutex> guard(lock);
+		space.wait(guard, [&]() { return queue.size() < capacity; });
+		queue.push_back(std::move(batch));
+		guard.unlock();
+		ready.notify_one();
+	}
+
+	/**
+	 * get the writer of the path, which is created if no one is using it
+	 */
+	static std::shared_ptr<dataset_writer> open(const std::string& path) {
+		static std::mutex registry_lock;
+		static std::map<std::string, std::weak_ptr<dataset_writer>> registry;
+		std::lock_guard<std::mutex> guard(registry_lock);
+		std::shared_ptr<dataset_writer> writer = registry[path].lock();
+		if (!writer) registry[path] = writer = std::make_shared<dataset_writer>(path);
+		return writer;
+	}
+
+private:
+	void loop() {
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			ready.wait(guard, [&]() { return stop || queue.size(); });
+			if (queue.empty()) break; // stop only after everything is written
+			std::vector<sample> batch = std::move(queue.front());
+			queue.pop_front();
+			guard.unlock();
+			space.notify_one();
+			out.write(reinterpret_cast<const char*>(batch.data()), sizeof(sample) * batch.size());
+			out.flush();
+			guard.lock();
+		}
+	}
+
+private:
+	std::ofstream out;
+	std::deque<std::vector<sample>> queue;
+	size_t capacity;
+	bool stop;
+	std::mutex lock;
+	std::condition_variable ready;
+	std::condition_variable space;
+	std::thread worker;
+};
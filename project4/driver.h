@@ -0,0 +1,75 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * driver.h: Game loop of concrete agent types
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "alloc.h"
+
+/**
+ * the game loop of two players of known types, e.g., game_driver<mcts_player, mcts_player>,
+ * which plays the same games as the loop of agent& in nogo.cpp
+ *
+ * the calls to the players are qualified by their types, so that they are bound at compile time and
+ * can be inlined instead of being dispatched through the virtual table of agent, and the names of
+ * the players are looked up once instead of from the properties of every episode
+ * note that the types must be the exact types of the players, since a qualified call skips any override
+ *
+ * a game is played as open_episode, run, and close_episode, so that the caller may record the game
+ * in between, e.g., by statistics::open_episode and statistics::close_episode
+ */
+template<class black_type, class white_type>
+class game_driver {
+public:
+	game_driver(black_type& black, white_type& white) : black(black), white(white),
+		black_id(black.black_type::name()), white_id(white.white_type::name()) {}
+
+public:
+	const std::string& black_name() const { return black_id; }
+	const std::string& white_name() const { return white_id; }
+	const std::string& winner_name(bool black_win) const { return black_win ? black_id : white_id; }
+
+	void open_episode() {
+		black.black_type::open_episode("~:" + white_id);
+		white.white_type::open_episode(black_id + ":~");
+	}
+
+	/**
+	 * play a game from the state of 'game', return true if black wins, i.e., makes the last move
+	 */
+	bool run(episode& game) {
+		while (game.take_black_turn() ? take_turn(game, black, allocation::black) : take_turn(game, white, allocation::white));
+		return game.step() % 2;
+	}
+
+	void close_episode(bool black_win) {
+		black.black_type::close_episode(winner_name(black_win));
+		white.white_type::close_episode(winner_name(black_win));
+	}
+
+private:
+	/**
+	 * let the player make a move, return false if the game is over
+	 */
+	template<class who>
+	static bool take_turn(episode& game, who& player, allocation::phase p) {
+		allocation::scope phase(p);
+		action move = player.who::take_action(game.state());
+		if (game.apply_action(move) != true) return false;
+		return !player.who::check_for_win(game.state());
+	}
+
+private:
+	black_type& black;
+	white_type& white;
+	std::string black_id, white_id;
+};
@@ -18,10 +18,12 @@
 #include "board.h"
 #include "action.h"
 #include "agent.h"
+#include "sgf.h"
+#include "alloc.h"
 
 class episode {
 public:
-	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) {
+	episode() : ep_state(initial_state()), ep_score(0), ep_time(0), ep_alloc() {
 		ep_moves.reserve(board::size_x * board::size_y);
 	}
 
@@ -30,11 +32,18 @@ public:
 	const board& state() const { return ep_state; }
 	board::score score() const { return ep_score; }
 
+	/**
+	 * the heap allocations of the thread between open_episode and close_episode, if --alloc is enabled
+	 */
+	allocation::counter allocs() const { return ep_alloc; }
+
 	void open_episode(const std::string& tag) {
 		ep_open = { tag, millisec() };
+		ep_alloc = allocation::current();
 	}
 	void close_episode(const std::string& tag) {
 		ep_close = { tag, millisec() };
+		ep_alloc = allocation::current() - ep_alloc;
 	}
 	bool apply_action(action move) {
 		board::reward reward = move.apply(state());
@@ -44,13 +53,21 @@ public:
 		return true;
 	}
 	agent& take_turns(agent& black, agent& white) {
-		ep_time = millisec();
-		return (step() % 2) ? white : black;
+		return take_black_turn() ? black : white;
 	}
 	agent& last_turns(agent& black, agent& white) {
 		return take_turns(white, black);
 	}
 
+	/**
+	 * the turns without the agents, e.g., for a loop of concrete agent types, see driver.h
+	 * take_black_turn starts the timer of the next move and returns whether black makes it
+	 */
+	bool take_black_turn() {
+		ep_time = millisec();
+		return step() % 2 == 0;
+	}
+
 public:
 	size_t step(unsigned who = -1u) const {
 		int size = ep_moves.size();
@@ -146,6 +163,34 @@ public:
 		return in;
 	}
 
+	/**
+	 * load the episode from a game record of the SGF reader, which is the same as operator >>
+	 * but works on the memory-mapped file directly
+	 */
+	bool load(const sgf_reader::token& game) {
+		*this = {};
+		bool tagged = false;
+		sgf_reader::cursor cur(game);
+		for (sgf_reader::property prop; cur.next(prop); ) {
+			if (prop.node == 0) {
+				if (prop.ident != "C" || prop.value.size < 4 || std::memcmp(prop.value.data, "TCG|", 4)) continue;
+				const char* p = prop.value.begin() + 4;
+				const char* bar = std::find(p, prop.value.end(), '|');
+				ep_open = meta::parse(sgf_reader::token(p, bar));
+				if (bar != prop.value.end()) ep_close = meta::parse(sgf_reader::token(bar + 1, prop.value.end()));
+				tagged = true;
+			} else if ((prop.ident == "B" || prop.ident == "W") && prop.value.size >= 2) {
+				int x = prop.value.data[0] - 'a';
+				int y = (board::size_y - 1) - (prop.value.data[1] - 'a');
+				ep_moves.emplace_back(action::place(x, y, prop.ident == "B" ? board::black : board::white));
+			} else if (prop.ident == "C" && ep_moves.size()) {
+				ep_moves.back().time = prop.value.number();
+			}
+		}
+		ep_score = 0;
+		return tagged;
+	}
+
 protected:
 
 	struct move {
@@ -184,6 +229,10 @@ protected:
 		friend std::istream& operator >>(std::istream& in, meta& m) {
 			return std::getline(in, m.tag, '@') >> std::dec >> m.when;
 		}
+		static meta parse(const sgf_reader::token& t) {
+			const char* at = std::find(t.begin(), t.end(), '@');
+			return meta(std::string(t.begin(), at), at != t.end() ? sgf_reader::token(at + 1, t.end()).number() : 0);
+		}
 	};
 
 	static board initial_state() {
@@ -199,6 +248,7 @@ private:
 	board::score ep_score;
 	std::vector<move> ep_moves;
 	time_t ep_time;
+	allocation::counter ep_alloc;
 
 	meta ep_open;
 	meta ep_close;
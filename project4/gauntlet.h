@@ -0,0 +1,212 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * gauntlet.h: Round-robin tournament with Elo estimation between player configurations
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "driver.h"
+#include "thread_pool.h"
+
+/**
+ * play a round-robin tournament between several mcts_player configurations in parallel,
+ * and fit the Elo ratings (Bradley-Terry model) of them with 95% confidence intervals
+ *
+ * each pair plays 'games' games with the colors swapped every game, and each game uses
+ * fresh players seeded by the game index, unless a seed is given in the configuration
+ *
+ * the games are played in parallel on the global thread pool
+ *
+ * the arguments are given as "key=value" pairs, e.g., "games=100"
+ *  'games': the number of games of each pair (default 100)
+ */
+class gauntlet {
+public:
+	gauntlet(const std::vector<std::string>& engines, const std::string& args = "")
+		: engines(engines), games(100) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "games") games = std::stoul(value);
+			else throw std::invalid_argument("invalid gauntlet argument: " + pair);
+		}
+		if (engines.size() < 2)
+			throw std::invalid_argument("gauntlet needs at least 2 engines");
+		for (size_t i = 0; i < engines.size(); i++) {
+			names.push_back(agent("name=engine" + std::to_string(i) + " " + engines[i]).name());
+			if (std::count(names.begin(), names.end(), names.back()) > 1)
+				throw std::invalid_argument("duplicated engine name: " + names.back());
+		}
+		for (size_t i = 0; i < engines.size(); i++)
+			for (size_t j = i + 1; j < engines.size(); j++)
+				pairs.emplace_back(i, j);
+	}
+
+public:
+	/**
+	 * play a single game between the configurations of black and white
+	 * return true if black wins
+	 */
+	bool play(size_t black, size_t white, size_t seed) const {
+		mcts_player b("seed=" + std::to_string(seed * 2) + " name=" + names[black] + " " + engines[black] + " role=black");
+		mcts_player w("seed=" + std::to_string(seed * 2 + 1) + " name=" + names[white] + " " + engines[white] + " role=white");
+		game_driver<mcts_player, mcts_player> driver(b, w);
+		driver.open_episode();
+		episode game;
+		bool black_win = driver.run(game);
+		driver.close_episode(black_win);
+		return black_win;
+	}
+
+	/**
+	 * play all games and print the report
+	 *
+	 * the format is
+	 * name    elo     95%     games   score
+	 * lgrf    35.2    21.7    200     55.0%
+	 * base    0.0     -       200     45.0%
+	 *
+	 * where the ratings are relative to the first engine, and
+	 * the confidence interval of each rating is elo +- the '95%' column
+	 */
+	void run(std::ostream& out = std::cout) {
+		size_t n = engines.size(), total = pairs.size() * games;
+		wins.assign(n, std::vector<size_t>(n, 0));
+
+		std::mutex lock;
+		size_t done = 0;
+		thread_pool::global().parallel_for(0, total, [&](size_t g) {
+			size_t i = pairs[g / games].first, j = pairs[g / games].second;
+			bool swap = g % 2;
+			size_t black = swap ? j : i, white = swap ? i : j;
+			bool black_win = play(black, white, g);
+			std::lock_guard<std::mutex> guard(lock);
+			wins[black_win ? black : white][black_win ? white : black]++;
+			if (++done % std::max<size_t>(total / 10, 1) == 0)
+				out << "gauntlet\t" << done << "/" << total << " games" << std::endl;
+		});
+
+		show(out);
+	}
+
+	/**
+	 * fit the ratings by the MM algorithm, with half a win and half a loss added to each pair
+	 * return the Elo ratings and the half widths of their 95% confidence intervals,
+	 * both are relative to the first engine
+	 */
+	std::pair<std::vector<double>, std::vector<double>> ratings() const {
+		size_t n = engines.size();
+		std::vector<std::vector<double>> w(n, std::vector<double>(n, 0));
+		for (size_t i = 0; i < n; i++)
+			for (size_t j = 0; j < n; j++)
+				if (i != j) w[i][j] = wins[i][j] + 0.5;
+
+		std::vector<double> gamma(n, 1.0);
+		for (int iter = 0; iter < 10000; iter++) {
+			double change = 0;
+			for (size_t i = 0; i < n; i++) {
+				double won = 0, denom = 0;
+				for (size_t j = 0; j < n; j++) {
+					if (i == j) continue;
+					won += w[i][j];
+					denom += (w[i][j] + w[j][i]) / (gamma[i] + gamma[j]);
+				}
+				double update = won / denom;
+				change = std::max(change, std::fabs(std::log(update / gamma[i])));
+				gamma[i] = update;
+			}
+			for (size_t i = 1; i < n; i++) gamma[i] /= gamma[0];
+			gamma[0] = 1;
+			if (change < 1e-10) break;
+		}
+
+		// the covariance of the natural ratings is the inverse of the Fisher information,
+		// where the first engine is fixed as the anchor
+		size_t m = n - 1;
+		std::vector<std::vector<double>> a(m, std::vector<double>(2 * m, 0));
+		for (size_t i = 1; i < n; i++) {
+			for (size_t j = 0; j < n; j++) {
+				if (i == j) continue;
+				double p = gamma[i] / (gamma[i] + gamma[j]);
+				double info = (w[i][j] + w[j][i]) * p * (1 - p);
+				a[i - 1][i - 1] += info;
+				if (j != 0) a[i - 1][j - 1] -= info;
+			}
+			a[i - 1][m + i - 1] = 1;
+		}
+		for (size_t c = 0; c < m; c++) { // Gauss-Jordan elimination, the matrix is positive definite
+			double pivot = a[c][c];
+			for (double& v : a[c]) v /= pivot;
+			for (size_t r = 0; r < m; r++) {
+				if (r == c) continue;
+				double f = a[r][c];
+				for (size_t k = 0; k < 2 * m; k++) a[r][k] -= f * a[c][k];
+			}
+		}
+
+		const double scale = 400 / std::log(10);
+		std::vector<double> elo(n, 0), error(n, 0);
+		for (size_t i = 1; i < n; i++) {
+			elo[i] = scale * std::log(gamma[i]);
+			error[i] = 1.96 * scale * std::sqrt(a[i - 1][m + i - 1]);
+		}
+		return { elo, error };
+	}
+
+	void show(std::ostream& out = std::cout) const {
+		size_t n = engines.size();
+		auto fit = ratings();
+		std::vector<size_t> order(n);
+		for (size_t i = 0; i < n; i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return fit.first[x] > fit.first[y]; });
+
+		std::ios ff(nullptr);
+		ff.copyfmt(out);
+		out << std::fixed << std::setprecision(1);
+		out << "name\t" "elo\t" "95%\t" "games\t" "score" << std::endl;
+		for (size_t i : order) {
+			size_t won = 0, played = 0;
+			for (size_t j = 0; j < n; j++) won += wins[i][j], played += wins[i][j] + wins[j][i];
+			out << names[i] << "\t" << fit.first[i] << "\t";
+			if (i) out << fit.second[i];
+			else   out << "-";
+			out << "\t" << played << "\t" << (played ? won * 100.0 / played : 0) << "%" << std::endl;
+		}
+		out << std::endl << "wins\t";
+		for (size_t j = 0; j < n; j++) out << names[j] << "\t";
+		out << std::endl;
+		for (size_t i = 0; i < n; i++) {
+			out << names[i] << "\t";
+			for (size_t j = 0; j < n; j++) {
+				if (i == j) out << "-\t";
+				else        out << wins[i][j] << "\t";
+			}
+			out << std::endl;
+		}
+		out.copyfmt(ff);
+	}
+
+private:
+	std::vector<std::string> engines;
+	std::vector<std::string> names;
+	std::vector<std::pair<size_t, size_t>> pairs;
+	std::vector<std::vector<size_t>> wins; // wins[i][j]: the number of games i won against j
+	size_t games;
+};
@@ -16,6 +16,14 @@
 #include "agent.h"
 #include "episode.h"
 #include "statistics.h"
+#include "perft.h"
+#include "analysis.h"
+#include "sprt.h"
+#include "gauntlet.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include "alloc.h"
+#include "writer.h"
 
 int main(int argc, const char* argv[]) {
 	std::cout << "HollowNoGo-Demo: ";
@@ -25,6 +33,13 @@ int main(int argc, const char* argv[]) {
 	size_t total = 1000, block = 0, limit = 0;
 	std::string black_args, white_args;
 	std::string load_path, save_path;
+	std::string perft_args, analysis_args, sprt_args, gauntlet_args;
+	std::vector<std::string> engines; // for gauntlet
+	std::string profile_args;
+	std::string alloc_args;
+	bool alloc = false;
+	size_t threads = 0; // for the global thread pool, 0 for all cores
+	bool pin = false;
 	std::string name = "TCG-HollowNoGo-Demo", version = "2022"; // for GTP shell
 	bool shell = false;
 	for (int i = 1; i < argc; i++) {
@@ -57,41 +72,106 @@ int main(int argc, const char* argv[]) {
 			version = next_opt();
 		} else if (match_arg("shell")) {
 			shell = true;
+		} else if (match_arg("perft")) {
+			perft_args = next_opt();
+		} else if (match_arg("analyze")) {
+			analysis_args = next_opt();
+		} else if (match_arg("sprt")) {
+			sprt_args = next_opt();
+		} else if (match_arg("gauntlet")) {
+			gauntlet_args = next_opt();
+		} else if (match_arg("engine")) {
+			engines.push_back(next_opt());
+		} else if (match_arg("profile")) {
+			profile_args = next_opt();
+		} else if (match_arg("alloc")) { // --alloc, or --alloc="sample=1000 top=10"
+			if (arg.find('=') != std::string::npos) alloc_args = next_opt();
+			alloc = true;
+		} else if (match_arg("threads")) {
+			threads = std::stoull(next_opt());
+		} else if (match_arg("pin")) {
+			pin = true;
 		}
 	}
+	thread_pool::configure(threads, pin);
+	std::unique_ptr<profiler> prof(profile_args.size() ? new profiler(profile_args) : nullptr);
+	if (alloc) {
+		allocation::start(alloc_args);
+		std::atexit([]() { allocation::report(); });
+	}
+
+	if (perft_args.size()) { // enumerate the legal move tree and quit
+		perft(perft_args).run(std::cout);
+		return 0;
+	}
+
+	if (analysis_args.size()) { // analyze the saved game records and quit
+		return analysis(analysis_args).run(std::cout) ? 0 : -1;
+	}
+
+	if (gauntlet_args.size()) { // play a round-robin tournament between the engines and quit
+		gauntlet(engines, gauntlet_args).run(std::cout);
+		return 0;
+	}
 
 	statistics stats(total, block, limit);
 
 	if (load_path.size()) {
-		std::ifstream in(load_path, std::ios::in);
-		in >> stats;
-		in.close();
+		if (!stats.load(load_path)) std::cerr << "cannot open " << load_path << std::endl;
 		if (stats.is_finished()) stats.summary();
 	}
 
+	// the episodes of --save are appended to the file by a background writer as soon as they finish,
+	// starting with the loaded ones, so that the statistics keep only the last block (or --limit) in memory
+	std::shared_ptr<record_writer> writer;
+	if (save_path.size()) {
+		writer = std::make_shared<record_writer>(save_path);
+		stats.stream(writer);
+	}
+
 	mcts_player black("name=black " + black_args + " role=black");
 	mcts_player white("name=white " + white_args + " role=white");
 
+	// for SPRT, the engines of --black and --white swap colors every game, and
+	// the match stops early once the test is decided, with --total as the maximum
+	std::unique_ptr<sprt> test;
+	std::unique_ptr<mcts_player> black_as_white, white_as_black;
+	if (sprt_args.size() && !shell) {
+		test.reset(new sprt(sprt_args));
+		black_as_white.reset(new mcts_player("name=black " + black_args + " role=white"));
+		white_as_black.reset(new mcts_player("name=white " + white_args + " role=black"));
+	}
+
 	if (!shell) { // launch standard local games
 		while (!stats.is_finished()) {
 //			std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
-			black.open_episode("~:" + white.name());
-			white.open_episode(black.name() + ":~");
+			bool swap = test && stats.step() % 2;
+			agent& first = swap ? *white_as_black : static_cast<agent&>(black);
+			agent& second = swap ? *black_as_white : static_cast<agent&>(white);
+			first.open_episode("~:" + second.name());
+			second.open_episode(first.name() + ":~");
 
-			stats.open_episode(black.name() + ":" + white.name());
+			stats.open_episode(first.name() + ":" + second.name());
 			episode& game = stats.back();
 			while (true) {
-				agent& who = game.take_turns(black, white);
+				agent& who = game.take_turns(first, second);
+				allocation::scope phase(&who == &first ? allocation::black : allocation::white);
 				action move = who.take_action(game.state());
 //				std::cerr << game.state() << "#" << game.step() << " " << who.name() << ": " << move << std::endl;
 				if (game.apply_action(move) != true) break;
 				if (who.check_for_win(game.state())) break;
 			}
-			agent& win = game.last_turns(black, white);
+			agent& win = game.last_turns(first, second);
 			stats.close_episode(win.name());
 
-			black.close_episode(win.name());
-			white.close_episode(win.name());
+			first.close_episode(win.name());
+			second.close_episode(win.name());
+
+			if (test) { // score of the engine of --black
+				test->update(win.name() == black.name() ? 1 : 0);
+				if (stats.step() % (block ? block : total) == 0 || test->is_finished()) test->show();
+				if (test->is_finished()) break;
+			}
 		}
 	} else { // launch GTP shell
 		for (std::string command; std::getline(std::cin, command); ) {
@@ -191,11 +271,7 @@ int main(int argc, const char* argv[]) {
 		}
 	}
 
-	if (save_path.size()) {
-		std::ofstream out(save_path, std::ios::out | std::ios::trunc);
-		out << stats;
-		out.close();
-	}
+	stats.stream(nullptr);
 
 	return 0;
 }
@@ -0,0 +1,115 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * perft.h: Enumerate the legal move tree for validating and benchmarking the board
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "thread_pool.h"
+
+/**
+ * count the leaf nodes of the full legal move tree to a given depth
+ *
+ * the subtrees of the first moves are counted in parallel on the global thread pool
+ *
+ * the arguments are given as "key=value" pairs, e.g., "depth=4 divide=1 moves=E5,D3"
+ *  'depth': the depth of the tree to enumerate (default 1)
+ *  'divide': show the leaf count of each first move if nonzero
+ *  'moves': the comma-separated moves to reach the root position, played alternately from black
+ */
+class perft {
+public:
+	perft(const std::string& args = "") : depth(1), divide(false) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			std::string value = pair.substr(pair.find('=') + 1);
+			if (key == "depth") depth = std::stoul(value);
+			else if (key == "divide") divide = std::stoul(value);
+			else if (key == "moves") play(value);
+			else throw std::invalid_argument("invalid perft argument: " + pair);
+		}
+	}
+
+public:
+	/**
+	 * count the leaf nodes of the legal move tree of the given depth from the state
+	 * note that a leaf is counted only if it is exactly at the given depth
+	 */
+	static uint64_t count(const board& state, unsigned depth) {
+		if (depth == 0) return 1;
+		uint64_t nodes = 0;
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board after = state;
+			if (after.place(board::point(i)) != board::legal) continue;
+			nodes += (depth > 1) ? count(after, depth - 1) : 1;
+		}
+		return nodes;
+	}
+
+	/**
+	 * enumerate the tree from the root position and print the report
+	 *
+	 * the format is
+	 * E5      1234        (only if divide is enabled)
+	 * depth = 3, nodes = 456789, time = 1.234 s, nps = 370169
+	 */
+	uint64_t run(std::ostream& out = std::cout) const {
+		std::vector<board::point> moves;
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board after = root;
+			if (after.place(board::point(i)) == board::legal) moves.emplace_back(i);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<uint64_t> nodes(moves.size(), 0);
+		if (depth > 0) {
+			thread_pool::global().parallel_for(0, moves.size(), [&](size_t i) {
+				board after = root;
+				after.place(moves[i]);
+				nodes[i] = count(after, depth - 1);
+			});
+		}
+		auto stop = std::chrono::steady_clock::now();
+
+		uint64_t total = depth ? 0 : 1;
+		for (size_t i = 0; i < moves.size(); i++) {
+			if (divide && depth) out << moves[i] << "\t" << nodes[i] << std::endl;
+			total += nodes[i];
+		}
+		double sec = std::chrono::duration<double>(stop - start).count();
+		out << "depth = " << depth << ", nodes = " << total << ", ";
+		out << "time = " << sec << " s, nps = " << uint64_t(sec > 0 ? total / sec : 0) << std::endl;
+		return total;
+	}
+
+	const board& state() const { return root; }
+
+private:
+	void play(const std::string& list) {
+		std::string res = list;
+		std::replace(res.begin(), res.end(), ',', ' ');
+		std::stringstream ss(res);
+		for (std::string move; ss >> move; ) {
+			if (root.place(board::point(move)) != board::legal)
+				throw std::invalid_argument("illegal perft move: " + move);
+		}
+	}
+
+private:
+	board root;
+	unsigned depth;
+	bool divide;
+};
@@ -0,0 +1,168 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * sgf.h: Streaming reader for SGF game records
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * memory-mapped reader for a file of SGF game records, e.g., the file saved by --save
+ *
+ * the file is never copied, games and properties are handed out as views into the mapping,
+ * so they are only valid while the reader is alive
+ */
+class sgf_reader {
+public:
+	/**
+	 * a view of a range of characters in the file
+	 */
+	struct token {
+		const char* data;
+		size_t size;
+		token(const char* data = nullptr, size_t size = 0) : data(data), size(size) {}
+		token(const char* begin, const char* end) : data(begin), size(end - begin) {}
+		const char* begin() const { return data; }
+		const char* end() const { return data + size; }
+		bool empty() const { return size == 0; }
+		bool operator ==(const char* s) const { return std::strlen(s) == size && std::memcmp(s, data, size) == 0; }
+		bool operator !=(const char* s) const { return !(*this == s); }
+		std::string str() const { return std::string(data, size); }
+		/**
+		 * parse the leading decimal digits, or return 0 if there is none
+		 */
+		uint64_t number() const {
+			uint64_t v = 0;
+			for (const char* p = begin(); p != end() && *p >= '0' && *p <= '9'; p++) v = v * 10 + (*p - '0');
+			return v;
+		}
+	};
+
+	/**
+	 * a single property value, e.g., B[ee] is { node, "B", "ee" }
+	 * where node is the index of the node in the game, i.e., 0 for the root node
+	 */
+	struct property {
+		size_t node;
+		token ident;
+		token value;
+	};
+
+	/**
+	 * cursor over the properties of a single game
+	 */
+	class cursor {
+	public:
+		cursor(const token& game) : p(game.begin()), last(game.end()), node(size_t(-1)), ident() {}
+
+		/**
+		 * move to the next property value, and return false at the end of the game
+		 * note that each value of a multi-valued property is reported separately
+		 */
+		bool next(property& prop) {
+			while (p != last) {
+				char c = *p;
+				if (c == ';') {
+					node++;
+					p++;
+				} else if (c >= 'A' && c <= 'Z') {
+					const char* begin = p;
+					while (p != last && *p >= 'A' && *p <= 'Z') p++;
+					ident = token(begin, p);
+				} else if (c == '[') {
+					const char* begin = ++p;
+					while (p != last && *p != ']') p += (*p == '\\' && p + 1 != last) ? 2 : 1;
+					prop = { node, ident, token(begin, p) };
+					if (p != last) p++;
+					return true;
+				} else {
+					p++;
+				}
+			}
+			return false;
+		}
+
+	private:
+		const char* p;
+		const char* last;
+		size_t node;
+		token ident;
+	};
+
+public:
+	sgf_reader(const std::string& path) : data(nullptr), size(0), mapped(false) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1) return;
+		struct stat st;
+		if (::fstat(fd, &st) == 0) {
+			void* map = st.st_size ? ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+			if (map != MAP_FAILED) { // an empty file is open but has nothing to map
+				if (map) ::madvise(map, st.st_size, MADV_SEQUENTIAL);
+				data = static_cast<const char*>(map);
+				size = map ? st.st_size : 0;
+				mapped = true;
+			}
+		}
+		::close(fd);
+	}
+	~sgf_reader() {
+		if (data) ::munmap(const_cast<char*>(data), size);
+	}
+	sgf_reader(const sgf_reader&) = delete;
+	sgf_reader& operator =(const sgf_reader&) = delete;
+
+	/**
+	 * return false if the file cannot be opened or mapped, e.g., it does not exist or it is a directory
+	 */
+	bool is_open() const { return mapped; }
+	token file() const { return token(data, size); }
+
+	/**
+	 * find the next game after from, i.e., the range between '(' and its matching ')'
+	 * return an empty token if there is no more game
+	 */
+	token next_game(const char*& from) const {
+		const char* last = data + size;
+		while (from != last && *from != '(') from++;
+		const char* begin = from;
+		int depth = 0;
+		for (bool value = false; from != last; from++) {
+			if (value) {
+				if (*from == '\\' && from + 1 != last) from++;
+				else if (*from == ']') value = false;
+			} else if (*from == '[') {
+				value = true;
+			} else if (*from == '(') {
+				depth++;
+			} else if (*from == ')' && --depth == 0) {
+				return token(begin, ++from);
+			}
+		}
+		return token();
+	}
+
+	/**
+	 * split the file into the ranges of all games
+	 */
+	std::vector<token> games() const {
+		std::vector<token> list;
+		const char* from = data;
+		for (token game; from && !(game = next_game(from)).empty(); list.push_back(game));
+		return list;
+	}
+
+private:
+	const char* data;
+	size_t size;
+	bool mapped;
+};
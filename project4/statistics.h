@@ -11,10 +11,14 @@
 #include <deque>
 #include <algorithm>
 #include <iostream>
+#include <iomanip>
 #include <sstream>
+#include <memory>
 #include "board.h"
 #include "action.h"
 #include "episode.h"
+#include "sgf.h"
+#include "writer.h"
 
 class statistics {
 public:
@@ -29,6 +33,7 @@ public:
 		: total(total),
 		  block(block ? block : total),
 		  limit(limit ? limit : total),
+		  given(limit != 0),
 		  count(0) {}
 
 public:
@@ -47,12 +52,16 @@ public:
 	 *  'ops = 125762 (132018|135377)': the average speed is 125762
 	 *                                  the average speed of black is 132018
 	 *                                  the average speed of white is 135377
+	 *
+	 * if --alloc is enabled, the heap allocations of the games follow, e.g.,
+	 *        alloc = 9886340.5/game, 155690.2/move, 8063420.1B/move
 	 */
 	void show(size_t blk = 0) const {
 		size_t num = std::min(data.size(), blk ?: block);
 		size_t sop = 0, Bop = 0, Wop = 0;
 		time_t sdu = 0, Bdu = 0, Wdu = 0;
 		size_t BW = 0, WW = 0;
+		allocation::counter alloc = {};
 		auto it = data.end();
 		for (size_t i = 0; i < num; i++) {
 			auto& ep = *(--it);
@@ -64,6 +73,7 @@ public:
 			sdu += ep.time();
 			Bdu += ep.time(action::black::type);
 			Wdu += ep.time(action::white::type);
+			alloc += ep.allocs();
 		}
 
 		std::cout << count << "\t";
@@ -76,6 +86,16 @@ public:
 		          <<     " (" << (Bop * 1000.0 / Bdu)
 		          <<      "|" << (Wop * 1000.0 / Wdu) << ")";
 		std::cout << std::endl;
+		if (allocation::is_enabled()) {
+			std::ios ff(nullptr);
+			ff.copyfmt(std::cout);
+			std::cout << std::fixed << std::setprecision(1);
+			std::cout << "\t" "alloc = " << (alloc.count * 1.0 / num) << "/game, ";
+			std::cout << (alloc.count * 1.0 / sop) << "/move, ";
+			std::cout << (alloc.bytes * 1.0 / sop) << "B/move";
+			std::cout << std::endl;
+			std::cout.copyfmt(ff);
+		}
 	}
 
 	void summary() const {
@@ -98,9 +118,27 @@ public:
 
 	void close_episode(const std::string& flag = "") {
 		data.back().close_episode(flag);
+		record(data.back());
 		if (count % block == 0) show();
 	}
 
+	/**
+	 * stream the kept and the coming finished episodes to a writer, e.g., of --save,
+	 * after which only the last block of episodes, or the given limit, is kept in memory for the statistics
+	 * stream(nullptr) stops streaming, where an ongoing episode, e.g., of the GTP shell, is written as it is
+	 */
+	void stream(std::shared_ptr<record_writer> out) {
+		if (!out) {
+			if (is_episode_ongoing()) record(data.back());
+			writer = out;
+			return;
+		}
+		writer = out;
+		for (const episode& rec : data) record(rec);
+		if (!given) limit = block;
+		while (data.size() > limit) data.pop_front();
+	}
+
 	episode& at(size_t i) {
 		return data.at(i);
 	}
@@ -114,6 +152,22 @@ public:
 		return count;
 	}
 
+	/**
+	 * load the records saved by operator << from a file through the SGF reader
+	 * return false if the file cannot be opened
+	 */
+	bool load(const std::string& path) {
+		sgf_reader file(path);
+		if (!file.is_open()) return false;
+		for (const sgf_reader::token& game : file.games()) {
+			data.emplace_back();
+			data.back().load(game);
+		}
+		total = std::max(total, data.size());
+		count = data.size();
+		return true;
+	}
+
 	friend std::ostream& operator <<(std::ostream& out, const statistics& stat) {
 		for (const episode& rec : stat.data) out << rec << std::endl;
 		return out;
@@ -128,10 +182,20 @@ public:
 		return in;
 	}
 
+private:
+	void record(const episode& rec) {
+		if (!writer) return;
+		std::stringstream ss;
+		ss << rec;
+		writer->push(ss.str());
+	}
+
 private:
 	size_t total;
 	size_t block;
 	size_t limit;
+	bool given; // whether the limit is given, which is kept when streaming
 	size_t count;
 	std::deque<episode> data;
+	std::shared_ptr<record_writer> writer;
 };
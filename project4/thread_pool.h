@@ -0,0 +1,267 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * thread_pool.h: Work-stealing task scheduler shared by all parallel features
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <iterator>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * work-stealing thread pool
+ *
+ * each worker owns a deque, runs its own tasks in LIFO order and steals from the others in FIFO order,
+ * tasks submitted by threads outside the pool go to an extra shared deque which workers also steal from
+ * a thread waiting for a task group runs the pending tasks of that group meanwhile, and sleeps once the
+ * rest of the group is running on other threads, so groups can be nested freely, e.g., a parallel search
+ * inside a game which is itself a task of a parallel tournament, and the waiting thread never picks up
+ * an unrelated long task, e.g., another game of the tournament
+ *
+ * the process-wide pool is global(), whose size is set by configure() before its first use,
+ * so that several parallel features in one process share the cores instead of oversubscribing them
+ */
+class thread_pool {
+public:
+	/**
+	 * a set of tasks that can be waited for or cancelled together
+	 * tasks of a cancelled group that have not started yet are skipped,
+	 * and running tasks may poll is_cancelled() to stop early
+	 * the first exception thrown by a task is rethrown by wait()
+	 */
+	class task_group {
+	public:
+		task_group(thread_pool& pool = thread_pool::global()) : pool(pool), pending(0), queued(0), cancelled(false) {}
+		~task_group() { try { wait(); } catch (...) {} }
+		task_group(const task_group&) = delete;
+		task_group& operator =(const task_group&) = delete;
+
+		void run(std::function<void()> fn) {
+			pending++;
+			queued++;
+			pool.submit({ std::move(fn), this });
+			std::lock_guard<std::mutex> guard(lock);
+			changed.notify_all(); // wake the waiter to run the new task
+		}
+		/**
+		 * run the queued tasks of the group, and sleep while the others are running on other threads
+		 */
+		void wait() {
+			while (pending.load() != 0) {
+				if (pool.run_pending(this)) continue;
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&]() { return pending.load() == 0 || queued.load() != 0; });
+			}
+			std::lock_guard<std::mutex> guard(lock);
+			if (error) {
+				std::exception_ptr e = error;
+				error = nullptr;
+				std::rethrow_exception(e);
+			}
+		}
+		void cancel() { cancelled = true; }
+		bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+	private:
+		friend class thread_pool;
+		thread_pool& pool;
+		std::atomic<size_t> pending; // the tasks not finished yet
+		std::atomic<size_t> queued; // the tasks not started yet
+		std::atomic<bool> cancelled;
+		std::mutex lock;
+		std::condition_variable changed;
+		std::exception_ptr error;
+	};
+
+public:
+	/**
+	 * create a pool of 'workers' threads, optionally pinned to cores in order
+	 * note that the threads waiting for task groups also run tasks, so a pool for
+	 * n-way parallelism needs only n - 1 workers
+	 */
+	thread_pool(size_t workers, bool pin = false) : queues(workers + 1), queued(0), stop(false) {
+		for (auto& q : queues) q.reset(new queue);
+		for (size_t i = 0; i < workers; i++) {
+			threads.emplace_back(&thread_pool::loop, this, i);
+#ifdef __linux__
+			if (pin) {
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &set);
+				pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpu_set_t), &set);
+			}
+#endif
+		}
+	}
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> guard(idle_lock);
+			stop = true;
+		}
+		idle.notify_all();
+		for (std::thread& th : threads) th.join();
+	}
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator =(const thread_pool&) = delete;
+
+	/**
+	 * the number of worker threads
+	 */
+	size_t size() const { return threads.size(); }
+
+	/**
+	 * the slot of the calling thread, i.e., the index of a worker in [0, size()),
+	 * or size() for any thread outside the pool
+	 * this is useful for indexing per-thread resources, e.g., a player for each thread
+	 */
+	size_t slot() const {
+		return current() == this ? index() : size();
+	}
+
+	/**
+	 * run fn(i) for i in [begin, end) in chunks of 'grain' indices, and wait for all of them
+	 */
+	void parallel_for(size_t begin, size_t end, const std::function<void(size_t)>& fn, size_t grain = 1) {
+		task_group group(*this);
+		grain = std::max<size_t>(grain, 1);
+		for (size_t i = begin; i < end; i += grain) {
+			size_t last = std::min(i + grain, end);
+			group.run([&fn, i, last]() { for (size_t j = i; j < last; j++) fn(j); });
+		}
+		group.wait();
+	}
+
+public:
+	/**
+	 * set the parallelism (including the calling thread) of the global pool, 0 for all cores
+	 * this takes effect only if it is called before the first use of global()
+	 */
+	static void configure(size_t threads, bool pin = false) {
+		settings().threads = threads;
+		settings().pin = pin;
+	}
+	static thread_pool& global() {
+		static thread_pool pool(std::max<size_t>(settings().threads ?: std::thread::hardware_concurrency(), 1) - 1, settings().pin);
+		return pool;
+	}
+
+private:
+	struct task {
+		std::function<void()> fn;
+		task_group* group;
+	};
+	struct queue {
+		std::mutex lock;
+		std::deque<task> tasks;
+	};
+	struct config {
+		size_t threads = 0;
+		bool pin = false;
+	};
+
+	static config& settings() { static config c; return c; }
+	static thread_pool*& current() { static thread_local thread_pool* pool = nullptr; return pool; }
+	static size_t& index() { static thread_local size_t i = 0; return i; }
+
+	void submit(task&& t) {
+		queue& q = *queues[slot()];
+		{
+			std::lock_guard<std::mutex> guard(q.lock);
+			q.tasks.push_back(std::move(t));
+		}
+		queued++;
+		{
+			std::lock_guard<std::mutex> guard(idle_lock);
+		}
+		idle.notify_one();
+	}
+
+	/**
+	 * pop a task from the own deque, or steal one from the others
+	 * only the tasks of the given group are considered if it is not nullptr
+	 */
+	bool acquire(task& t, task_group* only = nullptr) {
+		size_t self = slot(), n = queues.size();
+		auto match = [only](const task& x) { return !only || x.group == only; };
+		for (size_t k = 0; k < n; k++) {
+			queue& q = *queues[(self + k) % n];
+			std::lock_guard<std::mutex> guard(q.lock);
+			if (q.tasks.empty()) continue;
+			std::deque<task>::iterator it;
+			if (k == 0) {
+				auto rit = std::find_if(q.tasks.rbegin(), q.tasks.rend(), match);
+				if (rit == q.tasks.rend()) continue;
+				it = std::prev(rit.base());
+			} else {
+				it = std::find_if(q.tasks.begin(), q.tasks.end(), match);
+				if (it == q.tasks.end()) continue;
+			}
+			t = std::move(*it);
+			q.tasks.erase(it);
+			t.group->queued--;
+			queued--;
+			return true;
+		}
+		return false;
+	}
+
+	void execute(task& t) {
+		task_group& group = *t.group;
+		if (!group.is_cancelled()) {
+			try {
+				t.fn();
+			} catch (...) {
+				std::lock_guard<std::mutex> guard(group.lock);
+				if (!group.error) group.error = std::current_exception();
+			}
+		}
+		t.fn = nullptr;
+		std::lock_guard<std::mutex> guard(group.lock); // the group may be gone once the waiter sees the last task done
+		if (--group.pending == 0) group.changed.notify_all();
+	}
+
+	/**
+	 * run a single pending task (of the given group) if there is any
+	 */
+	bool run_pending(task_group* only = nullptr) {
+		task t;
+		if (!acquire(t, only)) return false;
+		execute(t);
+		return true;
+	}
+
+	void loop(size_t i) {
+		current() = this;
+		index() = i;
+		while (true) {
+			if (run_pending()) continue;
+			std::unique_lock<std::mutex> guard(idle_lock);
+			idle.wait(guard, [&]() { return stop || queued.load() != 0; });
+			if (stop) break;
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<queue>> queues; // queues[size()] is shared by the threads outside the pool
+	std::vector<std::thread> threads;
+	std::atomic<size_t> queued;
+	bool stop;
+	std::mutex idle_lock;
+	std::condition_variable idle;
+};
@@ -0,0 +1,108 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * trace.h: Low-overhead search tracer writing the Chrome trace-event format
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+/**
+ * tracer that records timed events into a fixed-size ring buffer
+ *
+ * recording is lock-free, a slot is claimed by an atomic increment so that several search
+ * threads can share the same tracer; when the buffer is full the oldest events are overwritten
+ * dumping should only happen when no thread is recording, e.g., at the end of take_action
+ *
+ * the dumped file can be opened by chrome://tracing or https://ui.perfetto.dev/
+ */
+class tracer {
+public:
+	struct event {
+		const char* name; // must be a string literal
+		uint64_t start; // nanoseconds since the tracer is created
+		uint64_t duration; // nanoseconds
+		unsigned tid;
+	};
+
+	/**
+	 * a scope that records an event when it ends
+	 * nothing is recorded (nor timed) if the tracer is nullptr
+	 */
+	class scope {
+	public:
+		scope(tracer* t, const char* name) : t(t), name(name), start(t ? t->now() : 0) {}
+		~scope() { if (t) t->record(name, start, t->now()); }
+		scope(const scope&) = delete;
+		scope& operator =(const scope&) = delete;
+	private:
+		tracer* t;
+		const char* name;
+		uint64_t start;
+	};
+
+public:
+	tracer(size_t capacity = 1 << 18) : ring(std::max<size_t>(capacity, 1)), head(0),
+		origin(std::chrono::steady_clock::now()) {}
+
+	uint64_t now() const {
+		auto elapsed = std::chrono::steady_clock::now() - origin;
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	}
+
+	void record(const char* name, uint64_t start, uint64_t stop) {
+		size_t slot = head.fetch_add(1, std::memory_order_relaxed);
+		ring[slot % ring.size()] = { name, start, stop - start, thread_id() };
+	}
+
+	/**
+	 * number of events recorded since the last clear, including the overwritten ones
+	 */
+	size_t recorded() const { return head.load(std::memory_order_relaxed); }
+	void clear() { head.store(0, std::memory_order_relaxed); }
+
+	/**
+	 * write the retained events as a trace-event JSON object, with extra key-value info in "otherData"
+	 */
+	bool dump(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info = {}) const {
+		std::ofstream out(path, std::ios::out | std::ios::trunc);
+		if (!out.is_open()) return false;
+		size_t last = recorded(), first = last > ring.size() ? last - ring.size() : 0;
+		out << std::fixed << std::setprecision(3);
+		out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{";
+		for (size_t i = 0; i < info.size(); i++)
+			out << (i ? "," : "") << '"' << info[i].first << "\":\"" << info[i].second << '"';
+		out << "},\"traceEvents\":[";
+		for (size_t i = first; i < last; i++) {
+			const event& e = ring[i % ring.size()];
+			out << (i != first ? ",\n" : "\n");
+			out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.tid;
+			out << ",\"ts\":" << (e.start / 1000.0) << ",\"dur\":" << (e.duration / 1000.0) << "}";
+		}
+		out << "\n]}" << std::endl;
+		return true;
+	}
+
+	/**
+	 * small sequential id of the calling thread, used as the "tid" of its events
+	 */
+	static unsigned thread_id() {
+		static std::atomic<unsigned> next(0);
+		static thread_local unsigned id = next++;
+		return id;
+	}
+
+private:
+	std::vector<event> ring;
+	std::atomic<size_t> head;
+	std::chrono::steady_clock::time_point origin;
+};
@@ -0,0 +1,93 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * writer.h: Background writer of game records
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+
+/**
+ * append records, one per line, to a file by a background thread, e.g., the episodes of --save
+ *
+ * the records are passed through a bounded queue, so that the game loop never waits for the disk
+ * unless 'capacity' records are pending, and the records are written and flushed at least every 'period'
+ * milliseconds, or every 1MB, so that a crash loses at most the records of the last period, and leaves
+ * only complete lines in the file
+ * the pending records are written and the file is closed when the writer is destroyed
+ * the file is truncated, or appended to if 'append' is set, e.g., when a training is resumed
+ */
+class record_writer {
+public:
+	record_writer(const std::string& path, bool append = false, size_t capacity = 4096, unsigned period = 1000)
+		: out(path, std::ios::out | (append ? std::ios::app : std::ios::trunc)), capacity(capacity), period(period), stop(false) {
+		if (!out.is_open()) throw std::runtime_error("cannot save records to " + path);
+		worker = std::thread(&record_writer::loop, this);
+	}
+	~record_writer() {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stop = true;
+		}
+		ready.notify_one();
+		worker.join();
+	}
+
+public:
+	/**
+	 * append a record, which blocks only if the queue is full
+	 */
+	void push(std::string&& record) {
+		std::unique_lock<std::mutex> guard(lock);
+		space.wait(guard, [this]() { return queue.size() < capacity; });
+		queue.push_back(std::move(record));
+		if (queue.size() == 1) ready.notify_one();
+	}
+
+private:
+	void loop() {
+		auto last = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			ready.wait_for(guard, std::chrono::milliseconds(period), [this]() { return stop || queue.size(); });
+			std::deque<std::string> batch;
+			batch.swap(queue);
+			bool done = stop;
+			guard.unlock();
+			space.notify_all();
+
+			for (const std::string& record : batch) buffer.append(record).push_back('\n');
+			auto now = std::chrono::steady_clock::now();
+			if (done || now - last >= std::chrono::milliseconds(period) || buffer.size() >= (1 << 20)) {
+				out.write(buffer.data(), buffer.size());
+				out.flush();
+				buffer.clear();
+				last = now;
+			}
+
+			guard.lock();
+			if (done && queue.empty()) break;
+		}
+	}
+
+private:
+	std::ofstream out;
+	std::string buffer; // the records not written yet, which are written as a whole so that no line is cut
+	size_t capacity;
+	unsigned period;
+	bool stop;
+	std::deque<std::string> queue;
+	std::mutex lock;
+	std::condition_variable ready, space;
+	std::thread worker;
+};